@@ -6,35 +6,36 @@
 #ifndef CHIP8_ASM_COMPHELPERS_H
 #define CHIP8_ASM_COMPHELPERS_H
 
-#include <string>       // std::stoi
+#include <string>
+#include <string_view>
 
 #include "types.h"
 #include "parser.h"
 
-// convert an hexadecimal string value to its integer value
-uint16_t convert(std::string value);
+// convert an hexadecimal string value to its integer value, at most max
+uint16_t convert(std::string_view value, uint16_t max);
 
 
 // Jump or Call operands
-uint16_t jumpOrCall(uint16_t, t_token, Parser*);
+uint16_t jumpOrCall(uint16_t, const t_token&, Parser*, t_fixups&);
 
 // Load operand
-uint16_t load(uint16_t, t_token, Parser*);
+uint16_t load(uint16_t, const t_token&, Parser*, t_fixups&);
 
 // Add operand
-uint16_t add(uint16_t, t_token, Parser*);
+uint16_t add(uint16_t, const t_token&, Parser*, t_fixups&);
 
 // Sub operand
-uint16_t sub(uint16_t, t_token, Parser*);
+uint16_t sub(uint16_t, const t_token&, Parser*, t_fixups&);
 
 // Logic operands
-uint16_t logic(uint16_t, t_token, Parser*);
+uint16_t logic(uint16_t, const t_token&, Parser*, t_fixups&);
 
 // Skip operands
-uint16_t skip(uint16_t, t_token, Parser*);
+uint16_t skip(uint16_t, const t_token&, Parser*, t_fixups&);
 
 // Miscellaneous operands
-uint16_t misc(uint16_t, t_token, Parser*);
+uint16_t misc(uint16_t, const t_token&, Parser*, t_fixups&);
 
 
 #endif // CHIP8_ASM_COMPHELPERS_H
\ No newline at end of file
@@ -0,0 +1,113 @@
+/*
+ * keywords.h
+ * Compile-time perfect hash of the assembler keywords
+ */
+
+#ifndef CHIP8_ASM_KEYWORDS_H
+#define CHIP8_ASM_KEYWORDS_H
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "types.h"
+
+
+// spelling of each keyword, indexed by KEYWORD
+constexpr std::string_view KEYWORD_NAMES[KEYWORD_COUNT] {
+    "",
+    "JP", "CALL", "LD", "SE", "SNE", "CLS", "RET", "SKP", "SKNP", "RND", "DRW",
+    "AND", "OR", "XOR", "SHR", "SHL", "ADD", "SUB", "SUBN",
+    "DT", "ST", "I", "K", "F", "B", "[I]",
+    "INCLUDE",
+};
+
+const size_t KEYWORD_MAX_LENGTH{7};
+const uint32_t KEYWORD_BITS{7};                         // 128 slots for 28 keywords
+
+
+/* FNV-1a on the text, started from a seed, the top bits give the slot
+ * Args:
+ *      text: the upper-cased token
+ *      seed: the seed found by keywordSeed()
+ * Returns:
+ *      the slot in the table
+ */
+constexpr uint32_t keywordSlot(std::string_view text, uint32_t seed)
+{
+    uint32_t hash = seed;
+    for(char c : text)
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x01000193;
+
+    return hash >> (32 - KEYWORD_BITS);
+}
+
+/* Find the first seed giving a distinct slot to every keyword
+ * Returns:
+ *      the seed, 0 if there is none
+ */
+constexpr uint32_t keywordSeed()
+{
+    for(uint32_t seed = 0x811C9DC5; seed != 0; seed++)
+    {
+        bool used[1 << KEYWORD_BITS] {};
+        bool collision {false};
+
+        for(size_t k = 1; (k < KEYWORD_COUNT) && !collision; k++)
+        {
+            uint32_t slot = keywordSlot(KEYWORD_NAMES[k], seed);
+            collision = used[slot];
+            used[slot] = true;
+        }
+
+        if( !collision )
+            return seed;
+    }
+
+    return 0;
+}
+
+const uint32_t KEYWORD_SEED{keywordSeed()};
+static_assert(KEYWORD_SEED != 0, "No perfect hash for the keywords.");
+
+
+// slot -> keyword table
+struct t_keywords
+{
+    KEYWORD slots[1 << KEYWORD_BITS];
+};
+
+constexpr t_keywords keywordTable()
+{
+    t_keywords table {};
+    for(size_t k = 1; k < KEYWORD_COUNT; k++)
+        table.slots[keywordSlot(KEYWORD_NAMES[k], KEYWORD_SEED)] = static_cast<KEYWORD>(k);
+
+    return table;
+}
+
+constexpr t_keywords KEYWORD_TABLE{keywordTable()};
+
+
+/* Resolve a keyword: one hash and one comparison
+ * Args:
+ *      text: the upper-cased token
+ * Returns:
+ *      the keyword, KEYWORD_NONE for anything else
+ */
+constexpr KEYWORD keyword(std::string_view text)
+{
+    if( text.empty() || (text.size() > KEYWORD_MAX_LENGTH) )
+        return KEYWORD_NONE;
+
+    KEYWORD k = KEYWORD_TABLE.slots[keywordSlot(text, KEYWORD_SEED)];
+    return (KEYWORD_NAMES[k] == text) ? k : KEYWORD_NONE;
+}
+
+static_assert(keyword("SUBN") == KEYWORD_SUBN, "Keyword table mismatch.");
+static_assert(keyword("[I]") == KEYWORD_MEMORY, "Keyword table mismatch.");
+static_assert(keyword("INCLUDE") == KEYWORD_INCLUDE, "Keyword table mismatch.");
+static_assert(keyword("LOOP") == KEYWORD_NONE, "Keyword table mismatch.");
+
+#endif // CHIP8_ASM_KEYWORDS_H
@@ -5,42 +5,33 @@
 #ifndef CHIP8_ASM_PARSER_H
 #define CHIP8_ASM_PARSER_H
 
-#include <iostream>
-#include <exception>
-#include <fstream>
-#include <utility>
+#include <string>
+#include <string_view>
 
 #include "types.h"
 
-// maximum size for a token
-const int MAX_TOKEN_LENGTH{20};
 
-
-// exception raised when the parsing is done
-class StopIteration: public std::exception
-{
-    public:
-        explicit StopIteration() { }
-};
-
-// parse a file and generate tokens
+/* The source is copied once and upper-cased in place, except the quoted
+ * texts: the tokens are views on this buffer, valid as long as the parser,
+ * and the lexer never allocates. The keyword of an operand is resolved
+ * here, once.
+ */
 class Parser
 {
     public:     // public methods
-        Parser(std::string);
+        explicit Parser(std::string_view source);
         ~Parser();
 
         t_token next();                     // return the next token
 
     private:    // private methods
-        char get();                         // return the next character in the stream
-        char peek();                        // peek the next character in the stream
+        t_token make(TOKEN_TYPE type, size_t begin, size_t end) const;
 
     private:    // private members
-        std::ifstream* is_{nullptr};            // input stream
-        char token_[MAX_TOKEN_LENGTH+1]{0};     // current token
-        TOKEN_TYPE type_{TOKEN_INIT};           // current token type
-        int offset_{0};                         // current character offset in the token string
+        std::string source_;                    // upper-cased source
+        size_t offset_{0};                      // current character offset in the source
+        uint32_t line_{1};                      // current line
+        size_t lineBegin_{0};                   // offset of the current line
 };
 
-#endif // CHIP8_ASM_PARSER_H
\ No newline at end of file
+#endif // CHIP8_ASM_PARSER_H
@@ -0,0 +1,42 @@
+/*
+ * peephole.h
+ * Peephole optimizer, run on the program once its labels are resolved
+ */
+
+#ifndef CHIP8_ASM_PEEPHOLE_H
+#define CHIP8_ASM_PEEPHOLE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+
+// what the pass changed
+struct t_peephole
+{
+    uint32_t threaded{0};           // jumps & calls sent to the end of a jump chain
+    uint32_t tailCalls{0};          // CALL x; RET turned into JP x
+    uint32_t folded{0};             // ADD Vx, #n merged into the previous one
+    uint32_t moves{0};              // LD Vx, Vx removed
+    uint32_t unreachable{0};        // instructions removed after a JP or a RET
+    uint16_t saved{0};              // bytes removed
+};
+
+/* Rewrite the program in place
+ * An instruction following a skip is never removed nor merged, and only the
+ * instructions without a label are. Code is only removed when every address
+ * into the program is a label: no JP V0 and no literal address in it.
+ * Args:
+ *      rom: the program, its label references resolved
+ *      size: its size, updated
+ *      instructions: true at the offset of each instruction, false for the data bytes
+ *      labels: the labels, moved with their code
+ *      fixups: the label references, rebuilt with their nnn field cleared
+ * Returns:
+ *      what the pass changed
+ */
+t_peephole peephole(uint8_t *rom, uint16_t &size, const std::vector<bool> &instructions,
+                    t_labels &labels, t_fixups &fixups);
+
+#endif // CHIP8_ASM_PEEPHOLE_H
@@ -6,8 +6,12 @@
 #define CHIP8_ASM_TYPES_H
 
 // includes
+#include <cstdint>
+#include <map>
 #include <string>
+#include <string_view>
 #include <utility>      // std::pair
+#include <vector>
 
 
 // Token types for the parser
@@ -19,14 +23,62 @@ enum TOKEN_TYPE
     TOKEN_LABEL,        // a label (xxx:)
     TOKEN_REGISTER,     // a register (V[0-F])
     TOKEN_BYTE,         // a data byte
+    TOKEN_STRING,       // a quoted text, case preserved
     TOKEN_EOL,          // end of line
     TOKEN_END,          // end of file
 };
 
-// a token is a type and a string
-typedef std::pair<TOKEN_TYPE, std::string> t_token;
+// Keywords of the language: the mnemonics, the special registers, the directives
+enum KEYWORD : uint8_t
+{
+    KEYWORD_NONE,       // not a keyword, a label for instance
+    KEYWORD_JP,
+    KEYWORD_CALL,
+    KEYWORD_LD,
+    KEYWORD_SE,
+    KEYWORD_SNE,
+    KEYWORD_CLS,
+    KEYWORD_RET,
+    KEYWORD_SKP,
+    KEYWORD_SKNP,
+    KEYWORD_RND,
+    KEYWORD_DRW,
+    KEYWORD_AND,
+    KEYWORD_OR,
+    KEYWORD_XOR,
+    KEYWORD_SHR,
+    KEYWORD_SHL,
+    KEYWORD_ADD,
+    KEYWORD_SUB,
+    KEYWORD_SUBN,
+    KEYWORD_DT,         // delay timer
+    KEYWORD_ST,         // sound timer
+    KEYWORD_I,          // index register
+    KEYWORD_K,          // key press
+    KEYWORD_F,          // font sprite
+    KEYWORD_B,          // BCD
+    KEYWORD_MEMORY,     // [I]
+    KEYWORD_INCLUDE,    // INCLUDE "file"
+    KEYWORD_COUNT
+};
+
+// a token is a type and its text, a view on the source kept by the parser
+struct t_token
+{
+    TOKEN_TYPE type;
+    std::string_view text;
+    uint32_t line;          // position of the token in the source, from 1
+    uint32_t column;
+    KEYWORD keyword{KEYWORD_NONE};  // resolved by the parser for the operands
+};
+
+// an instruction waiting for a label, the name is a view on the source
+typedef std::pair<uint16_t, std::string_view> t_label;
+
+// instructions waiting for the address of a label
+typedef std::vector<t_label> t_fixups;
 
-// definition of a label in the code
-typedef std::pair<uint16_t, std::string> t_label;
+// label locations in the code, the names are views on the source
+typedef std::map<std::string_view, uint16_t> t_labels;
 
 #endif // CHIP8_ASM_TYPES_H
\ No newline at end of file
@@ -7,15 +7,33 @@
 
 // includes
 #include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
 
-#include "asm/parser.h"
+#include "asm/types.h"
+#include "asm/peephole.h"
 
 // constants
 const int MAX_MEMORY_LENGTH{4096};                      // maximum allowed for code generation
 const int ROM_CODE_BEGIN{0x0200};                       // code start address
 
 
-// main disassembler class
+// an assembly error and the line it was found at
+struct AsmDiagnostic
+{
+    uint32_t line;
+    std::string message;
+    std::string file;
+};
+
+struct ObjectFile;
+
+/* main assembler class
+ * Every table used during the assembly belongs to the instance: distinct
+ * instances can assemble on distinct threads at the same time.
+ */
 class Assembler
 {
     public:     // public methods
@@ -28,12 +46,42 @@ class Assembler
         Assembler& operator=(const Assembler&) = delete;
         Assembler& operator=(Assembler&&) = delete;
 
+        std::vector<uint8_t> assemble(std::string_view source);    // empty in case of error
         bool compile(std::string filename);             // compile a ASM file
+        bool compileObject(std::string filename, ObjectFile &object);  // without resolving the labels
         void write(std::string filename);               // write the result to disk
 
+        const uint8_t* getCode() const { return ROM_; } // the result of the last compilation
+        uint16_t getSize() const { return PC_; }        // its size in bytes
+        uint32_t getLines() const { return lines_; }    // number of lines parsed
+        const std::vector<std::string>& getFiles() const { return files_; }  // files read, the includes too
+
+        void setOptimize(bool enabled) { optimize_ = enabled; }    // peephole pass on the ROM
+        const t_peephole& getOptimizations() const { return optimizations_; }
+
+        const std::vector<AsmDiagnostic>& getDiagnostics() const;
+        const std::string& getError() const;            // "file:line: message" if it failed
+
+    private:    // private methods
+        bool load(const std::string &filename, ObjectFile *object);
+        bool build(std::string_view source, ObjectFile *object);
+        void fail(const std::string &file, uint32_t line, std::string message);
+
     private:    // private members
         uint16_t PC_{0};                                // program counter
         uint8_t ROM_[MAX_MEMORY_LENGTH]{0};             // where the program is generated
+        uint32_t lines_{0};
+        bool optimize_{false};
+        t_peephole optimizations_;                      // what the last peephole pass changed
+
+        // views on the source being assembled, only valid during build()
+        t_fixups jumps_;                                // addresses waiting for a label
+        t_labels labels_;                               // label locations in the code
+
+        std::string name_;                              // main source, the INCLUDE are relative to it
+        std::vector<std::string> files_;                // files read by the last compilation, even a failed one
+        std::vector<AsmDiagnostic> diagnostics_;
+        std::string error_;                             // first diagnostic, formatted
 };
 
-#endif  // CHIP8_ASSEMBLER_H
\ No newline at end of file
+#endif  // CHIP8_ASSEMBLER_H
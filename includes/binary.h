@@ -0,0 +1,41 @@
+/*
+ * binary.h
+ * Little-endian helpers for the binary formats
+ */
+
+// guards
+#ifndef CHIP8_BINARY_H
+#define CHIP8_BINARY_H
+
+// includes
+#include "types.h"
+
+inline void putW(byte_t *buffer, word_t value)
+{
+    buffer[0] = (value & 0x00FF);
+    buffer[1] = (value & 0xFF00) >> 8;
+}
+
+inline void putL(byte_t *buffer, uint32_t value)
+{
+    putW(buffer, value & 0xFFFF);
+    putW(buffer + 2, value >> 16);
+}
+
+inline void putQ(byte_t *buffer, uint64_t value)
+{
+    putL(buffer, value & 0xFFFFFFFF);
+    putL(buffer + 4, value >> 32);
+}
+
+inline word_t getW(const byte_t *buffer)
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+inline uint32_t getL(const byte_t *buffer)
+{
+    return getW(buffer) | (static_cast<uint32_t>(getW(buffer + 2)) << 16);
+}
+
+#endif // CHIP8_BINARY_H
@@ -0,0 +1,104 @@
+/*
+ * chip8.h
+ * C interface of the libchip8 emulation core
+ *
+ * Every function returning an int returns a negative value on error, the
+ * reason is then given by c8_last_error(). A machine must not be used by
+ * two threads at the same time, distinct machines are independent.
+ */
+
+// guards
+#ifndef CHIP8_C_API_H
+#define CHIP8_C_API_H
+
+// includes
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(CHIP8_BUILD)
+#define C8_API __attribute__((visibility("default")))
+#else
+#define C8_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// version of this interface, bumped when it changes in an incompatible way
+#define C8_API_VERSION 1
+
+// screen layout: one byte per pixel, 0 or 1, row after row
+#define C8_SCREEN_WIDTH 64
+#define C8_SCREEN_HEIGHT 32
+
+// opaque machine handle
+typedef struct c8_machine c8_machine;
+
+// version of the library, compare with C8_API_VERSION
+C8_API int c8_version(void);
+
+// create a machine in its power-on state, NULL when out of memory
+C8_API c8_machine* c8_create(void);
+C8_API void c8_destroy(c8_machine *machine);
+
+// description of the last error that occurred on this machine, valid until the next one
+C8_API const char* c8_last_error(const c8_machine *machine);
+
+// load a ROM from a memory buffer and power the machine on
+C8_API int c8_load_rom(c8_machine *machine, const uint8_t *rom, size_t size);
+
+// power the machine on again, keeping the ROM
+C8_API int c8_reset(c8_machine *machine);
+
+// set the random generator state, for reproducible runs
+C8_API void c8_set_seed(c8_machine *machine, uint32_t seed);
+
+// execute instructions, returns the number executed
+C8_API int c8_step(c8_machine *machine, int cycles);
+
+// execute instructions then update the 60Hz timers
+C8_API int c8_run_frame(c8_machine *machine, int cycles);
+
+// keyboard status, bit N is set while key N is pressed
+C8_API void c8_set_keys(c8_machine *machine, uint16_t keys);
+C8_API uint16_t c8_get_keys(const c8_machine *machine);
+
+// the screen memory, valid as long as the machine exists
+C8_API const uint8_t* c8_framebuffer(c8_machine *machine);
+
+// size of the buffer needed by c8_snapshot
+C8_API size_t c8_snapshot_size(void);
+
+// capture the machine state, returns the number of bytes written
+C8_API int c8_snapshot(const c8_machine *machine, uint8_t *buffer, size_t size);
+
+// restore a state captured by c8_snapshot or saved by c8run
+C8_API int c8_restore(c8_machine *machine, const uint8_t *buffer, size_t size);
+
+// opaque batch of machines stepped in parallel
+typedef struct c8_vecenv c8_vecenv;
+
+// create count machines stepped by threads threads, the caller included
+C8_API c8_vecenv* c8_vecenv_create(int count, int threads);
+C8_API void c8_vecenv_destroy(c8_vecenv *env);
+C8_API const char* c8_vecenv_last_error(const c8_vecenv *env);
+
+// load the same ROM in every machine and power them on
+C8_API int c8_vecenv_load_rom(c8_vecenv *env, const uint8_t *rom, size_t size);
+
+// power one machine on with the given seed, or all of them when index is -1
+C8_API int c8_vecenv_reset(c8_vecenv *env, int index, uint32_t seed);
+
+// instructions executed per frame
+C8_API void c8_vecenv_set_cycles(c8_vecenv *env, int cycles);
+
+// set keys[i] on machine i, emulate frames frames on every machine and
+// write the screens in observations, uint8_t[count][32][64]
+C8_API int c8_vecenv_step(c8_vecenv *env, const uint16_t *keys, int frames, uint8_t *observations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHIP8_C_API_H
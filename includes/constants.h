@@ -93,6 +93,10 @@ namespace Constants
 {
     inline constexpr int SPRITE_WIDTH { 8 };
     inline constexpr int FONT_SIZE { 5 };
+
+    // frames per second and instructions executed per frame at speed 1
+    inline constexpr int FRAMES_PER_SECOND { 60 };
+    inline constexpr int CYCLES_PER_FRAME { 10 };
 };
 
 #endif // CHIP8_CONSTANTS_H
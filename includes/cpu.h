@@ -11,14 +11,19 @@
 #include <memory>
 #include "types.h"
 #include "mmu.h"
+#include "snapshot.h"
 
 // class definition
 class CPU
 {
     public:     // public methods
         CPU(MMU *pMMU);
+        CPU(MMU *pMMU, void *storage);
         ~CPU();
 
+        // size of the storage needed by the second constructor
+        static size_t storageSize();
+
         // disallow copy/move semantics
         CPU(const CPU&) = delete;
         CPU(CPU&&) = delete;
@@ -26,11 +31,24 @@ class CPU
         CPU& operator=(CPU&&) = delete;
 
         bool update();
+        int run(int cycles);
         void reset();
+        void setSeed(uint32_t seed);
+
+        void saveState(Snapshot &snapshot) const;
+        void saveState(CPUState &state) const;
+        void restoreState(const Snapshot &snapshot);
+        void restoreState(const CPUState &state);
 
     private:    // private members
         struct OpaqueData;
-        std::unique_ptr<OpaqueData> data_;
+
+        // the data is either owned or placed in a storage provided by the caller
+        struct Release {
+            bool owned {true};
+            void operator()(OpaqueData *data) const;
+        };
+        std::unique_ptr<OpaqueData, Release> data_;
 };
 
 #endif  // CHIP8_CPU_H
\ No newline at end of file
@@ -0,0 +1,28 @@
+/*
+ * delta.h
+ * XOR/RLE delta encoding between two memory images
+ */
+
+// guards
+#ifndef CHIP8_DELTA_H
+#define CHIP8_DELTA_H
+
+// includes
+#include <vector>
+#include "types.h"
+
+/* The delta is the XOR of the two images, run-length encoded:
+ *  - a control byte below 0x80 is followed by nothing and stands for
+ *    (control + 1) zero bytes, where both images are equal
+ *  - a control byte from 0x80 is followed by (control - 0x80 + 1) bytes
+ *    to XOR with the image
+ * As XOR is symmetric, the same delta turns base into image and image into base.
+ */
+
+// encode the delta between two images of the same size
+void deltaEncode(const byte_t *base, const byte_t *image, int size, std::vector<byte_t> &delta);
+
+// apply a delta onto an image, returns false if the delta does not match the image size
+bool deltaApply(const byte_t *delta, int length, byte_t *image, int size);
+
+#endif // CHIP8_DELTA_H
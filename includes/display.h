@@ -9,6 +9,7 @@
 
 // includes
 #include <memory>
+#include <string>
 #include "types.h"
 #include "mmu.h"
 
@@ -28,6 +29,9 @@ class Display
         // render the memory buffer onto the screen
         void render();
 
+        // change the window title
+        void setTitle(const std::string &title);
+
     private:
         struct OpaqueData;
         std::unique_ptr<OpaqueData> data_;
@@ -64,4 +64,31 @@ class VMError: public BaseExceptError
         { }
 };
 
+// exception thrown when a save state cannot be written or loaded
+class StateError: public BaseExceptError
+{
+    public:
+        explicit StateError(const char *message) :
+            BaseExceptError(message)
+        { }
+};
+
+// exception thrown when an input movie cannot be written, loaded or played
+class MovieError: public BaseExceptError
+{
+    public:
+        explicit MovieError(const char *message) :
+            BaseExceptError(message)
+        { }
+};
+
+// exception thrown when the ROM library cannot be scanned, loaded or written
+class LibraryError: public BaseExceptError
+{
+    public:
+        explicit LibraryError(const char *message) :
+            BaseExceptError(message)
+        { }
+};
+
 #endif // CHIP8_EXCEPT_H
\ No newline at end of file
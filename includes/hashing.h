@@ -0,0 +1,57 @@
+/*
+ * hashing.h
+ * Hash functions for the state hashes and the files referring to a ROM
+ */
+
+// guards
+#ifndef CHIP8_HASHING_H
+#define CHIP8_HASHING_H
+
+// includes
+#include <cstddef>
+#include <vector>
+#include "types.h"
+
+// splitmix64 finalizer, every input bit affects every output bit
+inline uint64_t hashMix(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// contribution of one memory byte to the memory hash
+inline uint64_t hashByte(word_t address, byte_t value)
+{
+    return hashMix((static_cast<uint64_t>(address) << 8) | value);
+}
+
+// FNV-1a hash of a ROM, identifies the program a file was made with
+inline uint32_t hashRom(const byte_t *rom, size_t size)
+{
+    uint32_t hash {2166136261u};
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ rom[i]) * 16777619u;
+    }
+    return hash;
+}
+
+inline uint32_t hashRom(const std::vector<byte_t> &rom)
+{
+    return hashRom(rom.data(), rom.size());
+}
+
+// 64-bit FNV-1a hash of a file content, keys the assembler object cache
+inline uint64_t hashContent(const void *content, size_t size)
+{
+    const byte_t *bytes = static_cast<const byte_t*>(content);
+
+    uint64_t hash {14695981039346656037ull};
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+#endif // CHIP8_HASHING_H
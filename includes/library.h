@@ -0,0 +1,80 @@
+/*
+ * library.h
+ * ROM library: an index of the ROMs found in a directory
+ */
+
+// guards
+#ifndef CHIP8_LIBRARY_H
+#define CHIP8_LIBRARY_H
+
+// includes
+#include <memory>
+#include <string>
+#include <vector>
+#include "types.h"
+
+/* Scanning a directory hashes every file fitting in the code zone and runs
+ * it headless for a few seconds without input under a memory profile. The
+ * results are kept in a text index, so that a launcher finds any ROM by name
+ * or hash without reading the files again; a rescan only analyses the files
+ * whose size or modification time changed.
+ *
+ * Index layout (version 1), one ROM per line, tab-separated fields
+ *
+ *      # c8lib 1
+ *      hash  size  modified  instructions  smc  stack  crash  name
+ *
+ *  hash            FNV-1a hash of the ROM, 8 hexadecimal digits
+ *  size            size in bytes
+ *  modified        modification time of the file, in file clock ticks
+ *  instructions    instructions executed by the analysis
+ *  smc             addresses both written and executed, 0 if none
+ *  stack           peak stack depth, in calls
+ *  crash           frame where the analysis stopped on an error, -1 if none
+ *  name            path relative to the scanned directory
+ */
+namespace LibraryFile
+{
+    inline constexpr int VERSION { 1 };
+    inline constexpr int ANALYSIS_FRAMES { 600 };
+    inline constexpr const char* INDEX_NAME { "c8lib.idx" };
+};
+
+class RomLibrary
+{
+    public:
+        struct Entry
+        {
+            std::string name;
+            uint32_t hash {0};
+            word_t size {0};
+            int64_t modified {0};
+            uint64_t instructions {0};
+            int selfModifying {0};
+            int stackDepth {0};
+            int crashFrame {-1};
+        };
+
+        RomLibrary();
+        ~RomLibrary();
+
+        // disallow copy/move semantics
+        RomLibrary(const RomLibrary&) = delete;
+        RomLibrary(RomLibrary&&) = delete;
+        RomLibrary& operator=(const RomLibrary&) = delete;
+        RomLibrary& operator=(RomLibrary&&) = delete;
+
+        int scan(const std::string &directory);
+
+        void load(const std::string &filename);
+        void save(const std::string &filename) const;
+
+        const Entry* find(const std::string &key) const;
+        const std::vector<Entry>& entries() const;
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif // CHIP8_LIBRARY_H
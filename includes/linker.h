@@ -0,0 +1,53 @@
+/*
+ * linker.h
+ * Chip8 linker: build a ROM from relocatable objects
+ */
+#ifndef CHIP8_LINKER_H
+#define CHIP8_LINKER_H
+
+// includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "assembler.h"
+#include "object.h"
+
+
+/* The objects are placed in the order they were added, the first one at
+ * ROM_CODE_BEGIN. A label is visible from every object and must be defined
+ * only once.
+ */
+class Linker
+{
+    public:     // public methods
+        Linker();                                       // constructor
+        ~Linker();                                      // destructor
+
+        // disable move/copy semantics
+        Linker(const Linker&) = delete;
+        Linker(Linker&&) = delete;
+        Linker& operator=(const Linker&) = delete;
+        Linker& operator=(Linker&&) = delete;
+
+        void add(ObjectFile object);                    // the next object of the ROM
+        bool link();                                    // place the objects & resolve the labels
+        void write(std::string filename);               // write the ROM to disk
+
+        const std::vector<uint8_t>& getCode() const { return ROM_; }
+
+        const std::vector<AsmDiagnostic>& getDiagnostics() const;
+        const std::string& getError() const;            // "file:line: message" if it failed
+
+    private:    // private methods
+        void fail(const std::string &file, uint32_t line, std::string message);
+
+    private:    // private members
+        std::vector<ObjectFile> objects_;
+        std::vector<uint8_t> ROM_;                      // the linked program
+
+        std::vector<AsmDiagnostic> diagnostics_;
+        std::string error_;                             // first diagnostic, formatted
+};
+
+#endif  // CHIP8_LINKER_H
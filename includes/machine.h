@@ -0,0 +1,76 @@
+/*
+ * machine.h
+ * Headless Chip8 machine (memory, CPU and timers)
+ */
+
+// guards
+#ifndef CHIP8_MACHINE_H
+#define CHIP8_MACHINE_H
+
+// includes
+#include <memory>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "mmu.h"
+#include "snapshot.h"
+
+// class definition
+class Machine
+{
+    public:
+        Machine();
+        explicit Machine(void *storage);
+        ~Machine();
+
+        // size of the storage needed by the second constructor
+        static size_t storageSize();
+
+        // disallow copy/move semantics, use clone() instead
+        Machine(const Machine&) = delete;
+        Machine(Machine&&) = delete;
+        Machine& operator=(const Machine&) = delete;
+        Machine& operator=(Machine&&) = delete;
+
+        void reset();
+        void powerOn();
+        void setSeed(uint32_t seed);
+        void loadRom(const byte_t *buffer, word_t size);
+        void loadRom(std::string filename);
+
+        int step(int cycles);
+        int runFrame(int cycles);
+        void updateTimers();
+
+        word_t getKeys() const;
+        void setKeys(word_t keys);
+
+        void snapshot(Snapshot &snapshot) const;
+        void restore(const Snapshot &snapshot);
+        void restore(const Snapshot &snapshot, uint64_t memoryHash);
+        void restore(const CPUState &state, const byte_t *memory);
+        void getRegisters(CPUState &state) const;
+        void setRegisters(const CPUState &state);
+        std::unique_ptr<Machine> clone() const;
+
+        void setHashing(bool enabled);
+        uint64_t memoryHash() const;
+        uint64_t stateHash() const;
+
+        const std::vector<byte_t>& getRom() const;
+        void bootImage(byte_t *memory) const;
+
+        MMU* getMMU();
+
+    private:
+        struct OpaqueData;
+
+        // the data is either owned or placed in a storage provided by the caller
+        struct Release {
+            bool owned {true};
+            void operator()(OpaqueData *data) const;
+        };
+        std::unique_ptr<OpaqueData, Release> data_;
+};
+
+#endif  // CHIP8_MACHINE_H
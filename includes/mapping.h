@@ -0,0 +1,65 @@
+/*
+ * mapping.h
+ * Read-only file mappings
+ */
+
+// guards
+#ifndef CHIP8_MAPPING_H
+#define CHIP8_MAPPING_H
+
+// includes
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "types.h"
+
+// read-only mapping of a file, released when going out of scope
+struct Mapping
+{
+    int fd {-1};
+    size_t size {0};
+    const byte_t *data {nullptr};
+
+    Mapping() = default;
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    ~Mapping()
+    {
+        if( data != nullptr )
+            ::munmap(const_cast<byte_t*>(data), size);
+        if( fd >= 0 )
+            ::close(fd);
+    }
+
+    /* Map a whole file, an empty file is opened but not mapped
+     * Args:
+     *      filename: the path of the file
+     * Returns:
+     *      False if the file cannot be opened or mapped
+     */
+    bool map(const std::string &filename)
+    {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if( fd < 0 )
+            return false;
+
+        off_t length = ::lseek(fd, 0, SEEK_END);
+        if( length < 0 )
+            return false;
+
+        size = length;
+        if( size == 0 )
+            return true;
+
+        void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( mapping == MAP_FAILED )
+            return false;
+
+        data = static_cast<const byte_t*>(mapping);
+        return true;
+    }
+};
+
+#endif // CHIP8_MAPPING_H
@@ -10,12 +10,17 @@
 // includes
 #include <memory>
 #include "types.h"
+#include "snapshot.h"
+#include "hashing.h"
+
+class MemoryProfile;
 
 // class definition
 class MMU
 {
     public:     // public methods
         MMU();
+        explicit MMU(byte_t *storage);
         ~MMU();
 
         // disallow copy/move semantics
@@ -30,12 +35,49 @@ class MMU
         void writeB(word_t address, byte_t value);
         void writeW(word_t address, word_t value);
 
-        void loadMemory(word_t address, word_t size, byte_t *buffer);
+        void loadMemory(word_t address, word_t size, const byte_t *buffer);
+        void fill(word_t address, word_t size, byte_t value);
+        void clear();
 
         byte_t* getPointer(word_t address);
 
+        void saveState(Snapshot &snapshot) const;
+        void restoreState(const Snapshot &snapshot);
+        void restoreState(const byte_t *memory);
+        void restoreState(const byte_t *memory, uint64_t hash);
+
+        // incremented each time the code zone is written
+        uint32_t getGeneration() const { return generation_; }
+
+        // incremental hash of the whole memory, maintained once enabled
+        void setHashing(bool enabled);
+        bool isHashing() const { return hashing_; }
+        uint64_t getHash() const { return hash_; }
+
+        // keep the hash up to date after a write through getPointer()
+        void hashWrite(word_t address, byte_t before, byte_t after)
+        {
+            if( hashing_ )
+                hash_ += hashByte(address, after) - hashByte(address, before);
+        }
+
+        // count the reads & writes in a profile, nullptr to stop
+        void setProfile(MemoryProfile *profile) { profile_ = profile; }
+        MemoryProfile* getProfile() const { return profile_; }
+
+    private:    // private methods
+        void rehash();
+
     private:    // private members
-        std::unique_ptr<byte_t[]> memory_;
+        std::unique_ptr<byte_t[]> owned_;
+        byte_t *memory_{nullptr};
+        uint32_t generation_{0};
+
+        // sum of hashByte() over every address
+        bool hashing_{false};
+        uint64_t hash_{0};
+
+        MemoryProfile *profile_{nullptr};
 };
 
 
@@ -0,0 +1,94 @@
+/*
+ * movie.h
+ * Input movies: deterministic recording and playback of a session
+ */
+
+// guards
+#ifndef CHIP8_MOVIE_H
+#define CHIP8_MOVIE_H
+
+// includes
+#include <memory>
+#include <string>
+#include "types.h"
+#include "machine.h"
+
+/* A machine only depends on its ROM, its random generator state and the
+ * keyboard status seen at each frame, so a session is replayed exactly from
+ * the initial seed and the frames where the input changed.
+ *
+ * File layout (version 1), all values little-endian
+ *
+ *  offset  size  field
+ *       0     4  magic "C8MV"
+ *       4     2  format version
+ *       6     2  flags (bit 0: per-frame trace following the events)
+ *       8     4  FNV-1a hash of the ROM
+ *      12     4  random generator state at power on
+ *      16     4  number of frames
+ *      20     2  instructions per frame at the start
+ *      22     2  reserved
+ *      24     4  number of events
+ *      28     4  reserved
+ *      32     -  events
+ *
+ * Each event is a LEB128 integer holding the number of frames since the
+ * previous event shifted left by 2, ORed with the event type, followed by
+ * its value:
+ *      0  keyboard status      2 bytes
+ *      1  instructions/frame   2 bytes
+ *      2  reset                4 bytes, the new random generator state
+ *
+ * A traced movie then holds, for each frame, the state reached at its end:
+ * a LEB128 mask of the fields that changed since the previous frame (bits
+ * 0-15: V0 to VF, 16: I, 17: PC, 18: SP, 19: delay timer, 20: sound timer,
+ * 21: random generator state), their new values (1, 2 or 4 bytes) and the
+ * low 32 bits of the machine state hash. Playback compares them frame by
+ * frame to catch the first desync.
+ */
+namespace MovieFile
+{
+    inline constexpr int VERSION { 1 };
+    inline constexpr int HEADER_SIZE { 32 };
+    inline constexpr int FLAG_TRACE { 0x0001 };
+};
+
+class Movie
+{
+    public:
+        Movie();
+        ~Movie();
+
+        // disallow copy/move semantics
+        Movie(const Movie&) = delete;
+        Movie(Movie&&) = delete;
+        Movie& operator=(const Movie&) = delete;
+        Movie& operator=(Movie&&) = delete;
+
+        // recording, recordFrame() is called before each frame and
+        // recordState() after it
+        void startRecording(Machine &machine, int cycles, bool trace = false);
+        void recordFrame(const Machine &machine, int cycles);
+        void recordState(Machine &machine);
+        void recordReset(const Machine &machine);
+
+        // playback, playFrame() is called before each frame and
+        // verifyFrame() after it
+        void startPlayback(Machine &machine);
+        bool playFrame(Machine &machine, int &cycles);
+        bool verifyFrame(Machine &machine);
+        const std::string& getDivergence() const;
+
+        void save(const std::string &filename) const;
+        void load(const std::string &filename);
+
+        uint32_t frames() const;                // length of the movie
+        uint32_t position() const;              // frames played so far
+        bool hasTrace() const;                  // holds the per-frame states
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif // CHIP8_MOVIE_H
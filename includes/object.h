@@ -0,0 +1,106 @@
+/*
+ * object.h
+ * Relocatable objects produced by the assembler and read by the linker
+ */
+
+// guards
+#ifndef CHIP8_OBJECT_H
+#define CHIP8_OBJECT_H
+
+// includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* An object is the code of one source and of the files it includes, with
+ * every label reference left as a fixup: the linker places the objects one
+ * after the other from ROM_CODE_BEGIN and patches the addresses. The labels
+ * of all the objects share a single namespace.
+ *
+ * Object layout (version 1), text, one record per line
+ *
+ *      # c8obj 1
+ *      source  hash  path          the source then every included file
+ *      code    bytes               the code, 2 hexadecimal digits per byte
+ *      symbol  offset  name        a label and its offset in the code
+ *      fixup   offset  line  name  file    an instruction waiting for a label
+ *
+ *  hash            hash of the file content, 16 hexadecimal digits
+ *  offset          offset in the code, 4 hexadecimal digits
+ *  line            line of the instruction in file, for the link errors
+ */
+namespace ObjectFormat
+{
+    inline constexpr int VERSION { 1 };
+    inline constexpr const char* EXTENSION { ".c8o" };
+};
+
+struct ObjectFile
+{
+    struct Source
+    {
+        std::string path;
+        uint64_t hash {0};
+    };
+
+    struct Symbol
+    {
+        std::string name;
+        uint16_t offset {0};
+    };
+
+    struct Fixup
+    {
+        uint16_t offset {0};
+        std::string name;
+        std::string file;
+        uint32_t line {0};
+    };
+
+    std::vector<Source> sources;            // the main source first
+    std::vector<uint8_t> code;
+    std::vector<Symbol> symbols;
+    std::vector<Fixup> fixups;
+
+    bool load(const std::string &filename);
+    bool save(const std::string &filename) const;
+};
+
+// write an address in the nnn field of an instruction
+inline void relocate(uint8_t *instruction, uint16_t address)
+{
+    instruction[0] = instruction[0] | (address & 0x0F00) >> 8;
+    instruction[1] = address & 0xFF;
+}
+
+// hash of a file content, 0 if it cannot be read
+uint64_t hashSource(const std::string &filename);
+
+
+/* Objects kept in a directory, named after the hash of their source path
+ * and content. An object is only reused when the content of every file it
+ * was assembled from is unchanged.
+ */
+class ObjectCache
+{
+    public:
+        explicit ObjectCache(std::string directory);
+        ~ObjectCache();
+
+        // disallow copy/move semantics
+        ObjectCache(const ObjectCache&) = delete;
+        ObjectCache(ObjectCache&&) = delete;
+        ObjectCache& operator=(const ObjectCache&) = delete;
+        ObjectCache& operator=(ObjectCache&&) = delete;
+
+        bool fetch(const std::string &source, ObjectFile &object) const;
+        bool store(const std::string &source, const ObjectFile &object) const;
+
+    private:
+        std::string path(const std::string &source) const;
+
+    private:
+        std::string directory_;
+};
+
+#endif // CHIP8_OBJECT_H
@@ -0,0 +1,55 @@
+/*
+ * perf.h
+ * Hardware performance counters around a piece of code (Linux)
+ */
+
+// guards
+#ifndef CHIP8_PERF_H
+#define CHIP8_PERF_H
+
+// includes
+#include <memory>
+#include <string>
+#include "types.h"
+
+/* Counts the events of the calling thread, user space only, between start()
+ * and stop(). Each counter is opened on its own: one the host does not
+ * support, or every one of them in a container without access to
+ * perf_event_open, is simply reported as unavailable.
+ */
+class PerfCounters
+{
+    public:
+        enum Counter {
+            CYCLES = 0,
+            INSTRUCTIONS,
+            BRANCH_MISSES,
+            L1D_MISSES,
+            COUNT
+        };
+
+        PerfCounters();
+        ~PerfCounters();
+
+        // disallow copy/move semantics
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters(PerfCounters&&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+        PerfCounters& operator=(PerfCounters&&) = delete;
+
+        void start();
+        void stop();
+
+        bool available() const;                 // at least one counter works
+        bool available(Counter counter) const;
+        uint64_t value(Counter counter) const;  // events counted by the last start/stop
+
+        const std::string& error() const;       // why counters are missing
+        static const char* name(Counter counter);
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif // CHIP8_PERF_H
@@ -0,0 +1,40 @@
+/*
+ * pool.h
+ * Pool of machines living in a single arena
+ */
+
+// guards
+#ifndef CHIP8_POOL_H
+#define CHIP8_POOL_H
+
+// includes
+#include <memory>
+#include "types.h"
+#include "machine.h"
+
+// class definition
+class MachinePool
+{
+    public:
+        explicit MachinePool(int capacity);
+        ~MachinePool();
+
+        // disallow copy/move semantics
+        MachinePool(const MachinePool&) = delete;
+        MachinePool(MachinePool&&) = delete;
+        MachinePool& operator=(const MachinePool&) = delete;
+        MachinePool& operator=(MachinePool&&) = delete;
+
+        Machine* acquire();
+        void release(Machine *machine);
+
+        int capacity() const;
+        int available() const;
+        size_t slotSize() const;
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif  // CHIP8_POOL_H
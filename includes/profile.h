@@ -0,0 +1,75 @@
+/*
+ * profile.h
+ * Memory access profile: per-address reads, writes & executions
+ */
+
+// guards
+#ifndef CHIP8_PROFILE_H
+#define CHIP8_PROFILE_H
+
+// includes
+#include <ostream>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "constants.h"
+
+/* Attached to an MMU, the profile counts the reads and writes going through
+ * it and, through the CPU, the execution of each instruction byte and the
+ * lowest stack pointer reached. Loading a ROM or restoring a state is not
+ * counted as a write.
+ *
+ * An address both written and executed is self-modifying code: a program
+ * without any can be run from cached or recompiled code.
+ */
+class MemoryProfile
+{
+    public:
+        MemoryProfile();
+        ~MemoryProfile();
+
+        // disallow copy/move semantics
+        MemoryProfile(const MemoryProfile&) = delete;
+        MemoryProfile(MemoryProfile&&) = delete;
+        MemoryProfile& operator=(const MemoryProfile&) = delete;
+        MemoryProfile& operator=(MemoryProfile&&) = delete;
+
+        void clear();
+
+        // called by the MMU & the CPU, the address is already checked
+        void read(word_t address) { reads_[address]++; }
+        void write(word_t address) { writes_[address]++; }
+        void execute(word_t address)
+        {
+            executes_[address]++;
+            if( address + 1 < MemoryZone::TOTAL_MEMORY_SIZE )
+                executes_[address + 1]++;
+            instructions_++;
+        }
+        void stack(word_t sp)
+        {
+            if( sp < lowest_ )
+                lowest_ = sp;
+        }
+
+        uint32_t reads(word_t address) const { return reads_[address]; }
+        uint32_t writes(word_t address) const { return writes_[address]; }
+        uint32_t executes(word_t address) const { return executes_[address]; }
+        uint64_t instructions() const { return instructions_; }
+
+        std::vector<word_t> selfModifying() const;
+        word_t lowestStack() const;
+        int peakDepth() const;
+
+        void report(std::ostream &out) const;
+        void save(const std::string &filename) const;
+
+    private:
+        std::vector<uint32_t> reads_;
+        std::vector<uint32_t> writes_;
+        std::vector<uint32_t> executes_;
+        uint64_t instructions_ {0};
+        word_t lowest_ {MemoryZone::STACK_END};
+};
+
+#endif // CHIP8_PROFILE_H
@@ -0,0 +1,51 @@
+/*
+ * rewind.h
+ * Rewind buffer built from periodic snapshots
+ */
+
+// guards
+#ifndef CHIP8_REWIND_H
+#define CHIP8_REWIND_H
+
+// includes
+#include <deque>
+#include <memory>
+#include <vector>
+#include "types.h"
+#include "machine.h"
+#include "snapshot.h"
+
+/* The newest snapshot is kept in full, the older ones as a ring of deltas
+ * (see delta.h), each delta turning a snapshot into the one before it.
+ */
+class RewindBuffer
+{
+    public:
+        RewindBuffer(int capacity, int interval);
+        ~RewindBuffer();
+
+        // disallow copy/move semantics
+        RewindBuffer(const RewindBuffer&) = delete;
+        RewindBuffer(RewindBuffer&&) = delete;
+        RewindBuffer& operator=(const RewindBuffer&) = delete;
+        RewindBuffer& operator=(RewindBuffer&&) = delete;
+
+        void record(const Machine &machine);    // to be called once per frame
+        bool rewind(Machine &machine);          // step back to the previous snapshot
+        void clear();
+
+        int size() const;                       // number of snapshots available
+        size_t memoryUsage() const;             // bytes used by the deltas
+
+    private:
+        int capacity_{0};                       // maximum number of deltas
+        int interval_{1};                       // frames between two snapshots
+        int frames_{0};                         // frames since the last snapshot
+        bool hasHead_{false};                   // a snapshot was recorded
+        bool atHead_{false};                    // the machine is on the newest snapshot
+        std::unique_ptr<Snapshot> head_;        // newest snapshot
+        std::unique_ptr<Snapshot> next_;        // scratch snapshot
+        std::deque<std::vector<byte_t>> deltas_;
+};
+
+#endif // CHIP8_REWIND_H
@@ -0,0 +1,53 @@
+/*
+ * savestate.h
+ * On-disk save states
+ */
+
+// guards
+#ifndef CHIP8_SAVESTATE_H
+#define CHIP8_SAVESTATE_H
+
+// includes
+#include <string>
+#include <vector>
+#include "types.h"
+#include "machine.h"
+
+/* File layout (version 1), all values little-endian
+ *
+ *  offset  size  field
+ *       0     4  magic "C8ST"
+ *       4     2  format version
+ *       6     2  flags (bit 0: memory delta-encoded against the boot image)
+ *       8     4  size of the memory image
+ *      12     4  size of the payload following the header
+ *      16     4  FNV-1a hash of the ROM loaded in the machine
+ *      20    16  registers V0 to VF
+ *      36     2  register I
+ *      38     2  register PC
+ *      40     2  register SP
+ *      42     2  reserved
+ *      44     4  random generator state
+ *      48    16  reserved
+ *      64     -  payload: raw memory image or delta (see delta.h)
+ */
+namespace SaveState
+{
+    inline constexpr int VERSION { 1 };
+    inline constexpr int HEADER_SIZE { 64 };
+    inline constexpr int FLAG_DELTA { 0x0001 };
+};
+
+// serialize the state of a machine in memory
+void saveState(const Machine &machine, std::vector<byte_t> &buffer, bool compress);
+
+// write the state of a machine to disk
+void saveState(const Machine &machine, const std::string &filename, bool compress);
+
+// restore the state of a machine from a serialized state
+void loadState(Machine &machine, const byte_t *buffer, size_t size);
+
+// restore the state of a machine from disk
+void loadState(Machine &machine, const std::string &filename);
+
+#endif // CHIP8_SAVESTATE_H
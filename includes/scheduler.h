@@ -0,0 +1,52 @@
+/*
+ * scheduler.h
+ * Cooperative scheduler interleaving many headless machines on one thread
+ */
+
+// guards
+#ifndef CHIP8_SCHEDULER_H
+#define CHIP8_SCHEDULER_H
+
+// includes
+#include <memory>
+#include "types.h"
+#include "machine.h"
+
+/* Every frame, each runnable machine runs its instruction budget then
+ * yields to the next one. A machine found blocked at the end of its frame is
+ * parked until it can make progress again:
+ *  - waiting for a key (LD Vx, K with no key pressed): until its keys change
+ *  - waiting for the delay timer (LD Vx, DT / SE Vx, 0 / JP loop): until
+ *    the timer expires
+ * A parked machine costs nothing per frame. When woken, or accessed through
+ * get(), it is brought to the current frame exactly as if it had been
+ * emulated all along.
+ */
+class Scheduler
+{
+    public:
+        explicit Scheduler(int cycles);
+        ~Scheduler();
+
+        // disallow copy/move semantics
+        Scheduler(const Scheduler&) = delete;
+        Scheduler(Scheduler&&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+        Scheduler& operator=(Scheduler&&) = delete;
+
+        int add(std::unique_ptr<Machine> machine);
+        Machine& get(int id);
+        void setKeys(int id, word_t keys);
+
+        void runFrame();
+
+        uint64_t getFrame() const;
+        int size() const;
+        int runnable() const;
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif  // CHIP8_SCHEDULER_H
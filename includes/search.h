@@ -0,0 +1,66 @@
+/*
+ * search.h
+ * Parallel breadth-first / beam search over input sequences
+ */
+
+// guards
+#ifndef CHIP8_SEARCH_H
+#define CHIP8_SEARCH_H
+
+// includes
+#include <functional>
+#include <memory>
+#include <vector>
+#include "types.h"
+#include "machine.h"
+
+/* Starting from the state of a machine, each step tries every action (a
+ * keyboard status held for a number of frames) on every state of the
+ * frontier. States already seen, identified by their 64-bit state hash, are
+ * pruned. With a beam width, only the best scored states of each depth are
+ * expanded.
+ *
+ * The new states of a depth are ordered by parent and action before the
+ * duplicates are removed, so the path found and the states kept by the beam
+ * do not depend on the number of threads. The frontier states are stored as
+ * deltas against the start state, run() raises a VMError when they exceed
+ * the memory limit (1 GiB by default).
+ *
+ * The goal and score functions are called concurrently from the workers,
+ * each with its own machine.
+ */
+class Search
+{
+    public:
+        using Goal = std::function<bool(Machine&)>;
+        using Score = std::function<int(Machine&)>;
+
+        explicit Search(const Machine &start);
+        ~Search();
+
+        // disallow copy/move semantics
+        Search(const Search&) = delete;
+        Search(Search&&) = delete;
+        Search& operator=(const Search&) = delete;
+        Search& operator=(Search&&) = delete;
+
+        void setActions(const std::vector<word_t> &actions);
+        void setFramesPerAction(int frames);
+        void setCycles(int cycles);
+        void setDepth(int depth);
+        void setBeamWidth(int width);
+        void setThreads(int threads);
+        void setCapacity(size_t states);
+        void setMemoryLimit(size_t bytes);
+
+        bool run(const Goal &goal, const Score &score = nullptr);
+
+        const std::vector<word_t>& getPath() const;
+        uint64_t getVisited() const;
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif  // CHIP8_SEARCH_H
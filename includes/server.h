@@ -0,0 +1,95 @@
+/*
+ * server.h
+ * Headless emulation server over a UNIX domain socket
+ */
+
+// guards
+#ifndef CHIP8_SERVER_H
+#define CHIP8_SERVER_H
+
+// includes
+#include <memory>
+#include <string>
+#include "types.h"
+
+/* Protocol (version 1), all values little-endian
+ *
+ * A client sends any number of requests on the same connection, each one
+ * is answered before the next one is read.
+ *
+ * Request
+ *  offset  size  field
+ *       0     4  magic "C8RQ"
+ *       4     2  protocol version
+ *       6     2  mode (see Protocol::Mode)
+ *       8     4  number of frames to emulate
+ *      12     4  instructions per frame, 0 for the default
+ *      16     4  random generator seed, 0 behaves as 1
+ *      20     4  size of the ROM
+ *      24     4  number of input events
+ *      28     4  reserved
+ *      32     -  ROM content
+ *       -     -  input events, 8 bytes each sorted by frame:
+ *                frame (4), keyboard status (2), reserved (2)
+ *                the keys are set before the frame is emulated
+ *
+ * Response
+ *  offset  size  field
+ *       0     4  magic "C8RS"
+ *       4     2  protocol version
+ *       6     2  status (see Protocol::Status)
+ *       8     4  number of frames emulated
+ *      12     4  size of the payload
+ *      16     -  payload
+ *                HASHES: one 64-bit FNV-1a hash of the screen per frame
+ *                SNAPSHOT: the final state, in the save state file layout
+ *                FRAMES: the screen memory after each frame
+ *                on error: the error message
+ */
+namespace Protocol
+{
+    inline constexpr int VERSION { 1 };
+    inline constexpr int REQUEST_SIZE { 32 };
+    inline constexpr int RESPONSE_SIZE { 16 };
+    inline constexpr int EVENT_SIZE { 8 };
+
+    // upper bounds of a request, raw frames are kept in memory until sent
+    inline constexpr uint32_t MAX_FRAMES { 1 << 20 };
+    inline constexpr uint32_t MAX_RAW_FRAMES { 1 << 14 };
+    inline constexpr uint32_t MAX_CYCLES { 1 << 16 };
+    inline constexpr uint32_t MAX_EVENTS { 1 << 20 };
+
+    enum Mode {
+        HASHES = 0,
+        SNAPSHOT = 1,
+        FRAMES = 2
+    };
+
+    enum Status {
+        OK = 0,
+        BAD_REQUEST = 1,
+        FAILURE = 2
+    };
+};
+
+// class definition
+class Server
+{
+    public:
+        Server(const std::string &path, int workers);
+        ~Server();
+
+        // disallow copy/move semantics
+        Server(const Server&) = delete;
+        Server(Server&&) = delete;
+        Server& operator=(const Server&) = delete;
+        Server& operator=(Server&&) = delete;
+
+        void run();
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif // CHIP8_SERVER_H
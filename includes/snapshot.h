@@ -0,0 +1,34 @@
+/*
+ * snapshot.h
+ * Machine state snapshot
+ */
+
+// guards
+#ifndef CHIP8_SNAPSHOT_H
+#define CHIP8_SNAPSHOT_H
+
+// includes
+#include "types.h"
+#include "constants.h"
+
+// CPU registers
+struct CPUState
+{
+    byte_t V[16];       // general purpose registers
+    word_t I;           // index register
+    word_t PC;          // program counter
+    word_t SP;          // stack pointer
+    uint32_t seed;      // state of the random generator
+};
+
+/* Full state of the machine
+ * The timers and the keyboard status live in the peripherals zone,
+ * so the memory image holds them as well.
+ */
+struct Snapshot
+{
+    CPUState cpu;
+    byte_t memory[MemoryZone::TOTAL_MEMORY_SIZE];
+};
+
+#endif // CHIP8_SNAPSHOT_H
@@ -0,0 +1,43 @@
+/*
+ * vecenv.h
+ * Vectorized environment: a batch of headless machines stepped in parallel
+ */
+
+// guards
+#ifndef CHIP8_VECENV_H
+#define CHIP8_VECENV_H
+
+// includes
+#include <memory>
+#include "types.h"
+#include "machine.h"
+
+// class definition
+class VecEnv
+{
+    public:
+        VecEnv(int count, int threads);
+        ~VecEnv();
+
+        // disallow copy/move semantics
+        VecEnv(const VecEnv&) = delete;
+        VecEnv(VecEnv&&) = delete;
+        VecEnv& operator=(const VecEnv&) = delete;
+        VecEnv& operator=(VecEnv&&) = delete;
+
+        int size() const;
+        Machine& get(int index);
+
+        void loadRom(const byte_t *buffer, word_t size);
+        void reset();
+        void reset(int index, uint32_t seed);
+        void setCycles(int cycles);
+
+        void step(const word_t *keys, int frames, byte_t *observations);
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif  // CHIP8_VECENV_H
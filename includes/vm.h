@@ -10,7 +10,10 @@
 // includes
 #include <memory>
 #include <string>
+#include <vector>
 #include "types.h"
+#include "machine.h"
+#include "snapshot.h"
 
 // class definition
 class VM
@@ -27,12 +30,26 @@ class VM
 
         void init();
         void run();
+        void setRunAhead(int frames);
+        void setTurboRate(int fps);
         void shutdown();
         void loadRom(std::string filename);
+        void watch(std::string filename, bool keepInput);
+        void saveState(std::string filename);
+        void loadState(std::string filename);
+        void recordMovie(std::string filename, bool trace);
+        void playMovie(std::string filename);
+
+        void snapshot(Snapshot &snapshot) const;
+        void restore(const Snapshot &snapshot);
+        std::unique_ptr<Machine> clone() const;
 
     private:
         struct OpaqueData;
         std::unique_ptr<OpaqueData> data_;
 };
 
+// load a ROM, or assemble a source ending with .asm, in the code zone
+void loadProgram(Machine &machine, const std::string &filename, std::vector<std::string> *files = nullptr);
+
 #endif  // CHIP8_VM_H
\ No newline at end of file
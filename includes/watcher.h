@@ -0,0 +1,39 @@
+/*
+ * watcher.h
+ * Notification of the changes made to a file (Linux inotify)
+ */
+
+// guards
+#ifndef CHIP8_WATCHER_H
+#define CHIP8_WATCHER_H
+
+// includes
+#include <memory>
+#include <string>
+#include <vector>
+
+/* The directories holding the files are watched rather than the files
+ * themselves: most editors save by writing a new file and renaming it over
+ * the old one, which would silently end a watch on the file.
+ */
+class FileWatcher
+{
+    public:
+        explicit FileWatcher(const std::string &filename);
+        ~FileWatcher();
+
+        // disallow copy/move semantics
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher(FileWatcher&&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+        FileWatcher& operator=(FileWatcher&&) = delete;
+
+        void watch(const std::vector<std::string> &filenames);     // replace the files watched
+        bool changed();                     // never blocks, true if any of the files changed
+
+    private:
+        struct OpaqueData;
+        std::unique_ptr<OpaqueData> data_;
+};
+
+#endif // CHIP8_WATCHER_H
@@ -8,7 +8,7 @@
 
 
 // Add operand
-uint16_t add(uint16_t PC, t_token t, Parser* p)
+uint16_t add(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t value{0};
 
@@ -16,33 +16,32 @@ uint16_t add(uint16_t PC, t_token t, Parser* p)
     t_token op1 = p->next();
     t_token op2 = p->next();
 
-    if( op1.first == TOKEN_REGISTER )
+    if( op1.type == TOKEN_REGISTER )
     {
-        int r1 = convert(op1.second);
-        int r2 = convert(op2.second);
+        int r1 = convert(op1.text, 0x0F);
 
         //  7xkk - ADD Vx, byte
-        if( op2.first == TOKEN_VALUE )
-            value = (0x7000) | (r1 & 0x0F) << 8 | (r2 & 0xFF);
+        if( op2.type == TOKEN_VALUE )
+            value = (0x7000) | (r1 & 0x0F) << 8 | convert(op2.text, 0xFF);
 
         // 8xy4 - ADD Vx, Vy
-        if( op2.first == TOKEN_REGISTER )
-            value = (0x8004) | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
+        if( op2.type == TOKEN_REGISTER )
+            value = (0x8004) | (r1 & 0x0F) << 8 | convert(op2.text, 0x0F) << 4;
 
         if( value == 0 )
             throw std::string("Invalid second operand for ADD.");
     }
 
-    if( op1.first == TOKEN_OPERAND )
+    if( op1.type == TOKEN_OPERAND )
     {
         // Fx1E - ADD I, Vx
-        if( op1.second.compare("I") != 0 )
+        if( op1.keyword != KEYWORD_I )
             throw std::string("Invalid first operand for ADD.");
 
-        if( op2.first != TOKEN_REGISTER )
+        if( op2.type != TOKEN_REGISTER )
             throw std::string("Invalid second operand for ADD.");
 
-        int r2 = convert(op2.second);
+        int r2 = convert(op2.text, 0x0F);
         value = (0xF01E) | (r2 & 0x0F) << 8;
     }
 
@@ -50,7 +49,7 @@ uint16_t add(uint16_t PC, t_token t, Parser* p)
 }
 
 // Sub operand
-uint16_t sub(uint16_t PC, t_token t, Parser* p)
+uint16_t sub(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t value{0};
 
@@ -58,21 +57,21 @@ uint16_t sub(uint16_t PC, t_token t, Parser* p)
     t_token op1 = p->next();
     t_token op2 = p->next();
 
-    if( op1.first != TOKEN_REGISTER )
+    if( op1.type != TOKEN_REGISTER )
         throw std::string("Invalid first operand for SUB.");
 
-    if( op2.first != TOKEN_REGISTER )
+    if( op2.type != TOKEN_REGISTER )
         throw std::string("Invalid second operand for SUB.");
 
-    uint16_t r1 = convert(op1.second);
-    uint16_t r2 = convert(op2.second);
+    uint16_t r1 = convert(op1.text, 0x0F);
+    uint16_t r2 = convert(op2.text, 0x0F);
 
     // 8xy5 - SUB Vx, Vy
-    if( t.second.compare("SUB") == 0 )
+    if( t.keyword == KEYWORD_SUB )
         value = 0x8005 | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
 
     // 8xy7 - SUBN Vx, Vy
-    if( t.second.compare("SUBN") == 0 )
+    if( t.keyword == KEYWORD_SUBN )
         value = 0x8007 | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
 
     return value;
@@ -3,16 +3,11 @@
  */
 
 // includes
-#include <list>
-
 #include "asm/comphelpers.h"
 
 
-// global table of jumps
-extern std::list<t_label> jumps_table;
-
 // Jump or Call operands
-uint16_t jumpOrCall(uint16_t PC, t_token t, Parser* p)
+uint16_t jumpOrCall(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t value{0};
     uint16_t r1{0};
@@ -21,14 +16,14 @@ uint16_t jumpOrCall(uint16_t PC, t_token t, Parser* p)
     t_token op1 = p->next();
 
     // special case for JP V0, addr
-    if( (t.second.compare("JP") == 0) && (op1.second.compare("V0") == 0) ) {
+    if( (t.keyword == KEYWORD_JP) && (op1.type == TOKEN_REGISTER) && (op1.text == "0") ) {
         // retrieve the next operand
         t_token op2 = p->next();
-        if( op2.first == TOKEN_VALUE ) {
-            r1 = convert(op2.second);
+        if( op2.type == TOKEN_VALUE ) {
+            r1 = convert(op2.text, 0x0FFF);
         } else {
-            if( op2.first == TOKEN_OPERAND ) {
-                jumps_table.push_back(std::make_pair(PC, op2.second));
+            if( op2.type == TOKEN_OPERAND ) {
+                fixups.emplace_back(PC, op2.text);
             } else {
                 throw std::string("Invalid operand in 'JP V0, nnn' instruction.");
             }
@@ -37,22 +32,22 @@ uint16_t jumpOrCall(uint16_t PC, t_token t, Parser* p)
     }
 
     // the label is an address
-    if( op1.first == TOKEN_VALUE ) {
-        r1 = convert(op1.second);
+    if( op1.type == TOKEN_VALUE ) {
+        r1 = convert(op1.text, 0x0FFF);
     } else {
-        if( op1.first == TOKEN_OPERAND ) {
-            jumps_table.push_back(std::make_pair(PC, op1.second));
+        if( op1.type == TOKEN_OPERAND ) {
+            fixups.emplace_back(PC, op1.text);
         } else {
             throw std::string("Invalid operand in 'JP' instruction.");
         }
     }
 
     // Jump
-    if( t.second.compare("JP") == 0)
+    if( t.keyword == KEYWORD_JP)
         value = 0x1000 | (r1 & 0x0FFF);
 
     // Call
-    if( t.second.compare("CALL") == 0)
+    if( t.keyword == KEYWORD_CALL)
         value = 0x2000 | (r1 & 0x0FFF);
 
     if( value == 0 )
@@ -61,7 +56,7 @@ uint16_t jumpOrCall(uint16_t PC, t_token t, Parser* p)
     return value;
 }
 
-uint16_t skip(uint16_t PC, t_token t, Parser* p)
+uint16_t skip(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t value{0};
 
@@ -69,30 +64,34 @@ uint16_t skip(uint16_t PC, t_token t, Parser* p)
     t_token op1 = p->next();
     t_token op2 = p->next();
 
-    uint16_t r1 = convert(op1.second);
-    uint16_t r2 = convert(op2.second);
+    uint16_t r1 = convert(op1.text, 0x0F);
+    uint16_t r2{0};
 
-    if( op2.first == TOKEN_VALUE )
+    if( op2.type == TOKEN_VALUE )
     {
+        r2 = convert(op2.text, 0xFF);
+
         // 3xkk - SE Vx, byte
-        if( t.second.compare("SE") == 0 )
+        if( t.keyword == KEYWORD_SE )
             value = 0x3000;
 
         // 4xkk - SNE Vx, byte
-        if( t.second.compare("SNE") == 0 )
+        if( t.keyword == KEYWORD_SNE )
             value = 0x4000;
 
         value = value | (r1 & 0x0F) << 8 | (r2 & 0xFF);
     }
 
-    if( op2.first == TOKEN_REGISTER )
+    if( op2.type == TOKEN_REGISTER )
     {
+        r2 = convert(op2.text, 0x0F);
+
         // 5xy0 - SE Vx, Vy
-        if( t.second.compare("SE") == 0 )
+        if( t.keyword == KEYWORD_SE )
             value = 0x5000;
 
         // 9xy0 - SNE Vx, Vy
-        if( t.second.compare("SNE") == 0 )
+        if( t.keyword == KEYWORD_SNE )
             value = 0x9000;
 
         value = value | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
@@ -3,16 +3,11 @@
  */
 
 // includes
-#include <list>
-
 #include "asm/comphelpers.h"
 
 
-// global table of jumps
-extern std::list<t_label> jumps_table;
-
 // Load operand
-uint16_t load(uint16_t PC, t_token t, Parser* p)
+uint16_t load(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t value{0};
     uint16_t r1{0}, r2{0};
@@ -21,36 +16,36 @@ uint16_t load(uint16_t PC, t_token t, Parser* p)
     t_token op1 = p->next();
     t_token op2 = p->next();
 
-    switch(op1.first)
+    switch(op1.type)
     {
         case TOKEN_REGISTER:
         {
             value = 0;
-            r1 = convert(op1.second);
+            r1 = convert(op1.text, 0x0F);
 
             // 6xkk - LD Vx, byte
-            if( op2.first == TOKEN_VALUE ) {
-                r2 = convert(op2.second);
+            if( op2.type == TOKEN_VALUE ) {
+                r2 = convert(op2.text, 0xFF);
                 value = 0x6000 | (r1 & 0x0F) << 8 | (r2 & 0xFF);
             }
 
             // 8xy0 - LD Vx, Vy
-            if( op2.first == TOKEN_REGISTER ) {
-                r2 = convert(op2.second);
+            if( op2.type == TOKEN_REGISTER ) {
+                r2 = convert(op2.text, 0x0F);
                 value = 0x8000 | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
             }
 
-            if( op2.first == TOKEN_OPERAND ) {
+            if( op2.type == TOKEN_OPERAND ) {
                 // Fx07 - LD Vx, DT
-                if( op2.second.compare("DT") == 0 )
+                if( op2.keyword == KEYWORD_DT )
                     value = 0xF007 | (r1 & 0x0F) << 8;
 
                 // Fx0A - LD Vx, K
-                if( op2.second.compare("K") == 0 )
+                if( op2.keyword == KEYWORD_K )
                     value = 0xF00A | (r1 & 0x0F) << 8;
 
                 // Fx65 - LD Vx, [I]
-                if( op2.second.compare("[I]") == 0 )
+                if( op2.keyword == KEYWORD_MEMORY )
                     value = 0xF065 | (r1 & 0x0F) << 8;
             }
 
@@ -61,14 +56,14 @@ uint16_t load(uint16_t PC, t_token t, Parser* p)
 
         case TOKEN_OPERAND:
         {
-            switch(op2.first)
+            switch(op2.type)
             {
                 case TOKEN_VALUE:   // Annn - LD I, addr
                 {
-                    if( op1.second.compare("I") != 0 )
+                    if( op1.keyword != KEYWORD_I )
                         throw std::string("Invalid first operand for LD.");
 
-                    r2 = convert(op2.second);
+                    r2 = convert(op2.text, 0x0FFF);
                     value = 0xA000 | (r2 & 0x0FFF);
                 }
                 break;
@@ -76,26 +71,26 @@ uint16_t load(uint16_t PC, t_token t, Parser* p)
                 case TOKEN_REGISTER:    // a register
                 {
                     value = 0;
-                    r2 = convert(op2.second);
+                    r2 = convert(op2.text, 0x0F);
 
                     // Fx15 - LD DT, Vx
-                    if(op1.second.compare("DT") == 0)
+                    if(op1.keyword == KEYWORD_DT)
                         value = 0xF015 | (r2 & 0x0F) << 8;
 
                     // Fx18 - LD ST, Vx
-                    if(op1.second.compare("ST") == 0)
+                    if(op1.keyword == KEYWORD_ST)
                         value = 0xF018 | (r2 & 0x0F) << 8;
 
                     // Fx29 - LD F, Vx
-                    if(op1.second.compare("F") == 0)
+                    if(op1.keyword == KEYWORD_F)
                         value = 0xF029 | (r2 & 0x0F) << 8;
 
                     // Fx33 - LD B, Vx
-                    if(op1.second.compare("B") == 0)
+                    if(op1.keyword == KEYWORD_B)
                         value = 0xF033 | (r2 & 0x0F) << 8;
 
                     // Fx55 - LD [I], Vx
-                    if(op1.second.compare("[I]") == 0)
+                    if(op1.keyword == KEYWORD_MEMORY)
                         value = 0xF055 | (r2 & 0x0F) << 8;
 
                     if( value == 0 )
@@ -107,7 +102,7 @@ uint16_t load(uint16_t PC, t_token t, Parser* p)
                 {
                     value = 0xA000;
                     // add this to jumps list
-                    jumps_table.push_back(std::make_pair(PC, op2.second));
+                    fixups.emplace_back(PC, op2.text);
                 }
                 break;
 
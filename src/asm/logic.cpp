@@ -8,7 +8,7 @@
 
 
 // Logic operands
-uint16_t logic(uint16_t PC, t_token t, Parser* p)
+uint16_t logic(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t r1{0},r2{0};
 
@@ -16,30 +16,30 @@ uint16_t logic(uint16_t PC, t_token t, Parser* p)
     t_token op1 = p->next();
     t_token op2 = p->next();
 
-    if( op1.first != TOKEN_REGISTER )
+    if( op1.type != TOKEN_REGISTER )
         throw std::string("Invalid first operand.");
     else
-        r1 = convert(op1.second);
+        r1 = convert(op1.text, 0x0F);
 
-    if( t.second.compare("SHR") == 0 )
+    if( t.keyword == KEYWORD_SHR )
         return 0x8006 | (r1 & 0x0F) << 8;
 
-    if( t.second.compare("SHL") == 0 )
+    if( t.keyword == KEYWORD_SHL )
         return 0x800E | (r1 & 0x0F) << 8;
 
 
-    if( op2.first != TOKEN_REGISTER )
+    if( op2.type != TOKEN_REGISTER )
         throw std::string("Invalid second operand.");
     else
-        r2 = convert(op2.second);
+        r2 = convert(op2.text, 0x0F);
 
-    if( t.second.compare("OR") == 0 )
+    if( t.keyword == KEYWORD_OR )
         return 0x8001 | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
 
-    if( t.second.compare("AND") == 0 )
+    if( t.keyword == KEYWORD_AND )
         return 0x8002 | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
 
-    if( t.second.compare("XOR") == 0 )
+    if( t.keyword == KEYWORD_XOR )
         return 0x8003 | (r1 & 0x0F) << 8 | (r2 & 0x0F) << 4;
 
     // no matching instruction found
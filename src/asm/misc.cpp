@@ -4,76 +4,97 @@
  */
 
 // includes
+#include <charconv>     // std::from_chars
+
 #include "asm/comphelpers.h"
 
-// convert an hexadecimal string value to its integer value
-uint16_t convert(std::string value)
+/* Convert an hexadecimal string value to its integer value
+ * Args:
+ *      value: the digits, with or without a 0X prefix
+ *      max: the largest value the operand holds
+ * Returns:
+ *      the value, never truncated
+ */
+uint16_t convert(std::string_view value, uint16_t max)
 {
-    // try to convert the string
-    try {
-        return std::stoi(value, nullptr, 16);
-    } catch(std::invalid_argument) {
+    const char *first = value.data();
+    const char *last = value.data() + value.size();
+
+    // the source is upper-cased, skip a 0X prefix
+    if( (value.size() > 2) && (value[0] == '0') && (value[1] == 'X') )
+        first += 2;
+
+    int number{0};
+    std::from_chars_result result = std::from_chars(first, last, number, 16);
+
+    // every character is a digit
+    if( (result.ec == std::errc::invalid_argument) || (result.ptr != last) )
         throw std::string("Invalid argument type.");
-    }
+
+    if( (result.ec == std::errc::result_out_of_range) || (number < 0) || (number > max) )
+        throw std::string("Invalid value.");
+
+    return static_cast<uint16_t>(number);
 }
 
 
 // Miscellaneous operands
-uint16_t misc(uint16_t PC, t_token t, Parser* p)
+uint16_t misc(uint16_t PC, const t_token& t, Parser* p, t_fixups& fixups)
 {
     uint16_t value{0};
     uint16_t r1{0}, r2{0}, r3{0};
 
     // 00E0 - CLS
-    if(t.second.compare("CLS") == 0)
+    if(t.keyword == KEYWORD_CLS)
         return 0x00E0;
 
     // 00EE - RET
-    if(t.second.compare("RET") == 0)
+    if(t.keyword == KEYWORD_RET)
         return 0x00EE;
 
     // retrieve a first operand
     t_token op1 = p->next();
-    r1 = convert(op1.second);
+    r1 = convert(op1.text, 0x0F);
 
     // Ex9E - SKP Vx
-    if( t.second.compare("SKP") == 0 )
+    if( t.keyword == KEYWORD_SKP )
         return 0xE09E | (r1 & 0x0F) << 8;
 
     // ExA1 - SKNP Vx
-    if( t.second.compare("SKNP") == 0 )
+    if( t.keyword == KEYWORD_SKNP )
         return 0xE0A1 | (r1 & 0x0F) << 8;
 
     // retrieve a second operand
     t_token op2 = p->next();
-    r2 = convert(op2.second);
 
     // Cxkk - RND Vx, byte
-    if( t.second.compare("RND") == 0 )
+    if( t.keyword == KEYWORD_RND )
     {
-        if( op1.first != TOKEN_REGISTER )
+        if( op1.type != TOKEN_REGISTER )
             throw std::string("Invalid first argument in RND operation.");
 
-        if( op2.first != TOKEN_VALUE )
+        if( op2.type != TOKEN_VALUE )
             throw std::string("Invalid second argument in RND operation.");
 
+        r2 = convert(op2.text, 0xFF);
         return 0xC000 | (r1 & 0x0F) << 8 | (r2 & 0xFF);
     }
 
     // Dxyn - DRW Vx, Vy, n
-    if( t.second.compare("DRW") == 0 )
+    if( t.keyword == KEYWORD_DRW )
     {
         // DRW has a third operand
         t_token op3 = p->next();
 
-        if( op1.first != TOKEN_REGISTER )
+        if( op1.type != TOKEN_REGISTER )
             throw std::string("Invalid first argument in DRW operation.");
 
-        if( op2.first != TOKEN_REGISTER )
+        if( op2.type != TOKEN_REGISTER )
             throw std::string("Invalid second argument in DRW operation.");
 
-        if( op3.first == TOKEN_VALUE )
-            r3 = convert(op3.second);
+        r2 = convert(op2.text, 0x0F);
+        if( op3.type == TOKEN_VALUE )
+            r3 = convert(op3.text, 0x0F);
         else
             throw std::string("Invalid third argument in DRW operation.");
 
@@ -4,118 +4,117 @@
  */
 
 // includes
-#include <cstring>
+#include <algorithm>
+#include <cctype>
 
+#include "asm/keywords.h"
 #include "asm/parser.h"
 
-// constructor
-Parser::Parser(std::string filename) :
-    is_(new (std::nothrow) std::ifstream (filename.c_str(), std::fstream::in))
+// characters ending a token
+static bool isSeparator(char c)
 {
-    if( is_ == nullptr )
-        throw std::string("Unable to allocate memory for opening the file.");
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == ',') || (c == ';') || (c == '\n');
+}
 
-    if( !is_->is_open() )
-        throw std::string("Unable to open the file.");
+// constructor
+Parser::Parser(std::string_view source) :
+    source_(source)
+{
+    // quoted texts keep their case, up to the end of the line at most
+    bool quoted {false};
+    std::transform(source_.begin(), source_.end(), source_.begin(), [&quoted](unsigned char c) {
+        if( (c == '"') || (c == '\n') )
+            quoted = (c == '"') && !quoted;
+        return quoted ? static_cast<char>(c) : static_cast<char>(std::toupper(c));
+    });
 }
 
 // destructor
 Parser::~Parser()
 {
-    if( is_->is_open() )
-        is_->close();
 }
 
-// return the next character
-char Parser::get()
+// build a token from a part of the current line
+t_token Parser::make(TOKEN_TYPE type, size_t begin, size_t end) const
 {
-    char c;
-    is_->get(c);
-    if( is_->eof() )
-        throw StopIteration();
-
-    return c;
-}
-
-// peek the next character in the file
-char Parser::peek()
-{
-    if( is_->eof() )
-        throw StopIteration();
-
-    return is_->peek();
+    return t_token{type,
+                   std::string_view(source_).substr(begin, end - begin),
+                   line_,
+                   static_cast<uint32_t>(begin - lineBegin_ + 1)};
 }
 
 // return the next operand
 t_token Parser::next()
 {
-    try
+    const size_t size = source_.size();
+
+    while( offset_ < size )
     {
-        ::memset(token_, 0, 20);
-        offset_ = 0;
-        while(true)
-        {
-            char car = get();
-
-            // remove trailing space at the beginning
-            if( (offset_ == 0) && (car == ' ') ) {
-                while(car == ' ')
-                    car = get();
-            }
-
-            // remove comments
-            if( car == ';' ) {
-                while(car != '\n')
-                    car = get();
-            }
-
-            // end of line
-            if( car == '\n' ) {
-                return std::make_pair(TOKEN_EOL, "");
-            }
-
-            // detect tokens
-            if( offset_ ) {
-                // label
-                if( car == ':' ) {
-                    // remove the rest of the line
-                    while(peek() != '\n')
-                        get();
-
-                    return std::make_pair(TOKEN_LABEL, token_);
-                }
-
-                // operand separator
-                if( car == ' ' || car == ',' || peek() == '\n') {
-                    // insert the character
-                    if(peek() == '\n')
-                        token_[offset_] = toupper(car);
-
-                    // token is a value
-                    if( token_[0] == '#' ) {
-                        return std::make_pair(TOKEN_VALUE, &token_[1]);
-                    }
-
-                    // token is a Vx register
-                    if( token_[0] == 'V' ) {
-                        return std::make_pair(TOKEN_REGISTER, &token_[1]);
-                    }
-
-                    if( ::strcmp(token_, "DB") == 0) {
-                        return std::make_pair(TOKEN_BYTE, token_);
-                    }
-
-                    return std::make_pair(TOKEN_OPERAND, token_);
-                }
-            }
-
-            // record the character
-            token_[offset_++] = toupper(car);
-            if( offset_ > MAX_TOKEN_LENGTH )
-                throw std::string("The token is too big.");
+        char car = source_[offset_];
+
+        // end of line
+        if( car == '\n' ) {
+            t_token token = make(TOKEN_EOL, offset_, offset_);
+            offset_++;
+            line_++;
+            lineBegin_ = offset_;
+            return token;
+        }
+
+        // remove comments
+        if( car == ';' ) {
+            while( (offset_ < size) && (source_[offset_] != '\n') )
+                offset_++;
+            continue;
+        }
+
+        // spaces & operand separators
+        if( isSeparator(car) ) {
+            offset_++;
+            continue;
         }
 
-    } catch(StopIteration) {
-        return std::make_pair(TOKEN_END, "");
+        // quoted text, on a single line
+        if( car == '"' ) {
+            size_t begin = ++offset_;
+            while( (offset_ < size) && (source_[offset_] != '"') && (source_[offset_] != '\n') )
+                offset_++;
+
+            if( (offset_ == size) || (source_[offset_] != '"') )
+                throw std::string("Missing closing quote.");
+
+            return make(TOKEN_STRING, begin, offset_++);
+        }
+
+        size_t begin = offset_;
+        while( (offset_ < size) && !isSeparator(source_[offset_]) )
+            offset_++;
+        size_t end = offset_;
+
+        // label, the rest of the line is ignored
+        if( source_[end - 1] == ':' ) {
+            while( (offset_ < size) && (source_[offset_] != '\n') )
+                offset_++;
+            return make(TOKEN_LABEL, begin, end - 1);
+        }
+
+        // token is a value
+        if( source_[begin] == '#' )
+            return make(TOKEN_VALUE, begin + 1, end);
+
+        // token is a Vx register
+        if( (end - begin == 2) && (source_[begin] == 'V') && std::isxdigit(static_cast<unsigned char>(source_[begin + 1])) )
+            return make(TOKEN_REGISTER, begin + 1, end);
+
+        // token is a series of bytes
+        if( (end - begin == 2) && (source_[begin] == 'D') && (source_[begin + 1] == 'B') )
+            return make(TOKEN_BYTE, begin, end);
+
+        // mnemonic, special register or label name
+        t_token token = make(TOKEN_OPERAND, begin, end);
+        token.keyword = keyword(token.text);
+        return token;
     }
-}
\ No newline at end of file
+
+    return make(TOKEN_END, size, size);
+}
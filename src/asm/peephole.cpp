@@ -0,0 +1,311 @@
+/*
+ * peephole.cpp
+ * Peephole optimizer, run on the program once its labels are resolved
+ */
+
+// includes
+#include <cstring>      // ::memmove
+#include <string_view>
+
+#include "assembler.h"
+#include "asm/peephole.h"
+
+
+// an instruction, or a run of data bytes the pass never touches
+struct t_unit
+{
+    uint16_t offset;
+    uint16_t size;
+    bool instruction;
+    bool labeled;                   // a label points here
+    bool removed;
+    uint16_t opcode;
+    std::string_view label;         // label giving the nnn field, empty for an address
+};
+
+// 3xkk, 4xkk, 5xy0, 9xy0, Ex9E & ExA1 skip the next instruction
+static bool isSkip(uint16_t opcode)
+{
+    switch(opcode & 0xF000)
+    {
+        case 0x3000:
+        case 0x4000:
+            return true;
+
+        case 0x5000:
+        case 0x9000:
+            return (opcode & 0x000F) == 0;
+
+        case 0xE000:
+            return ((opcode & 0x00FF) == 0x9E) || ((opcode & 0x00FF) == 0xA1);
+    }
+
+    return false;
+}
+
+// the program seen as units, with their neighbours among the units left
+class Program
+{
+    public:
+        std::vector<t_unit> units;
+        std::vector<size_t> unitAt;         // unit starting at each offset, the end included
+
+        // the next unit left after u, units.size() at the end
+        size_t next(size_t u) const
+        {
+            do { u++; } while( (u < units.size()) && units[u].removed );
+            return u;
+        }
+
+        // the instruction skipped or not by its previous unit left
+        bool skipped(size_t u) const
+        {
+            while( u-- > 0 ) {
+                if( !units[u].removed )
+                    return units[u].instruction && isSkip(units[u].opcode);
+            }
+            return false;
+        }
+
+        // the unit executed from a label, units.size() at the end
+        size_t target(const t_labels &labels, std::string_view label) const
+        {
+            size_t u = unitAt[labels.find(label)->second];
+            return (u < units.size()) && units[u].removed ? next(u) : u;
+        }
+
+        // an instruction left, matching the opcode mask
+        bool is(size_t u, uint16_t mask, uint16_t value) const
+        {
+            return (u < units.size()) && units[u].instruction && !units[u].removed && ((units[u].opcode & mask) == value);
+        }
+
+        // remove a unit, its labels go to the next one
+        void remove(size_t u)
+        {
+            units[u].removed = true;
+            size_t n = next(u);
+            if( units[u].labeled && (n < units.size()) )
+                units[n].labeled = true;
+        }
+};
+
+
+// JP a; a: JP b => JP b, same for CALL, a loop of jumps is left alone
+static bool thread(Program &program, const t_labels &labels, t_peephole &stats)
+{
+    bool changed {false};
+
+    for(size_t u = 0; u < program.units.size(); u++)
+    {
+        if( !(program.is(u, 0xF000, 0x1000) || program.is(u, 0xF000, 0x2000)) || program.units[u].label.empty() )
+            continue;
+
+        std::vector<bool> visited(program.units.size(), false);
+        visited[u] = true;
+
+        std::string_view label = program.units[u].label;
+        size_t t = program.target(labels, label);
+        bool loop {false};
+
+        while( program.is(t, 0xF000, 0x1000) && !program.units[t].label.empty() )
+        {
+            if( visited[t] ) {
+                loop = true;
+                break;
+            }
+            visited[t] = true;
+
+            label = program.units[t].label;
+            t = program.target(labels, label);
+        }
+
+        if( !loop && (label != program.units[u].label) ) {
+            program.units[u].label = label;
+            stats.threaded++;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// CALL x; RET => JP x, the RET is left to the unreachable code removal
+static bool tailCalls(Program &program, t_peephole &stats)
+{
+    bool changed {false};
+
+    for(size_t u = 0; u < program.units.size(); u++)
+    {
+        if( program.is(u, 0xF000, 0x2000) && !program.skipped(u) && program.is(program.next(u), 0xFFFF, 0x00EE) ) {
+            program.units[u].opcode = 0x1000 | (program.units[u].opcode & 0x0FFF);
+            stats.tailCalls++;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// ADD Vx, #n; ADD Vx, #m => ADD Vx, #n+m, 7xkk leaves VF alone
+static bool fold(Program &program, t_peephole &stats)
+{
+    bool changed {false};
+
+    for(size_t u = 0; u < program.units.size(); u++)
+    {
+        if( !program.is(u, 0xF000, 0x7000) || program.skipped(u) )
+            continue;
+
+        t_unit &add = program.units[u];
+        size_t n = program.next(u);
+        while( program.is(n, 0xFF00, add.opcode & 0xFF00) && !program.units[n].labeled )
+        {
+            add.opcode = (add.opcode & 0xFF00) | ((add.opcode + program.units[n].opcode) & 0x00FF);
+            program.remove(n);
+            stats.folded++;
+            changed = true;
+            n = program.next(u);
+        }
+    }
+
+    return changed;
+}
+
+// LD Vx, Vx does nothing
+static bool moves(Program &program, t_peephole &stats)
+{
+    bool changed {false};
+
+    for(size_t u = 0; u < program.units.size(); u++)
+    {
+        uint16_t opcode = program.units[u].opcode;
+        if( program.is(u, 0xF00F, 0x8000) && (((opcode >> 8) & 0x0F) == ((opcode >> 4) & 0x0F)) && !program.skipped(u) ) {
+            program.remove(u);
+            stats.moves++;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// nothing reaches the instructions without a label after a JP or a RET
+static bool unreachable(Program &program, t_peephole &stats)
+{
+    bool changed {false};
+
+    for(size_t u = 0; u < program.units.size(); u++)
+    {
+        if( !(program.is(u, 0xF000, 0x1000) || program.is(u, 0xFFFF, 0x00EE)) || program.skipped(u) )
+            continue;
+
+        size_t n = program.next(u);
+        while( program.is(n, 0x0000, 0x0000) && !program.units[n].labeled )
+        {
+            program.remove(n);
+            stats.unreachable++;
+            changed = true;
+            n = program.next(n);
+        }
+    }
+
+    return changed;
+}
+
+
+t_peephole peephole(uint8_t *rom, uint16_t &size, const std::vector<bool> &instructions,
+                    t_labels &labels, t_fixups &fixups)
+{
+    t_peephole stats;
+    Program program;
+
+    // label references by offset
+    std::vector<std::string_view> references(size);
+    for(const auto &fixup : fixups)
+        references[fixup.first] = fixup.second;
+
+    std::vector<bool> labeled(size + 1, false);
+    for(const auto &label : labels)
+        labeled[label.second] = true;
+
+    // cut the program in units: an instruction, or data bytes up to the next instruction or label
+    bool shrink {true};
+    program.unitAt.assign(size + 1, 0);
+    for(uint16_t offset = 0; offset < size; )
+    {
+        t_unit unit {offset, 2, instructions[offset], labeled[offset], false, 0, std::string_view()};
+
+        if( unit.instruction ) {
+            unit.opcode = (rom[offset] << 8) | rom[offset + 1];
+            unit.label = references[offset];
+
+            // an address computed or written as a number, the code cannot move
+            uint16_t kind = unit.opcode & 0xF000;
+            uint16_t address = unit.opcode & 0x0FFF;
+            if( kind == 0xB000 )
+                shrink = false;
+            if( ((kind == 0x1000) || (kind == 0x2000) || (kind == 0xA000)) && unit.label.empty() &&
+                (address >= ROM_CODE_BEGIN) && (address <= ROM_CODE_BEGIN + size) )
+                shrink = false;
+        } else {
+            unit.size = 1;
+            while( (offset + unit.size < size) && !instructions[offset + unit.size] && !labeled[offset + unit.size] )
+                unit.size++;
+        }
+
+        program.unitAt[offset] = program.units.size();
+        program.units.push_back(unit);
+        offset += unit.size;
+    }
+    program.unitAt[size] = program.units.size();
+
+    // until nothing changes
+    bool changed {true};
+    while( changed )
+    {
+        changed = thread(program, labels, stats);
+        changed = tailCalls(program, stats) || changed;
+
+        if( shrink ) {
+            changed = fold(program, stats) || changed;
+            changed = moves(program, stats) || changed;
+            changed = unreachable(program, stats) || changed;
+        }
+    }
+
+    // move the code, a unit removed takes the offset of the next unit left
+    std::vector<uint16_t> moved(program.units.size() + 1);
+    uint16_t pc {0};
+    fixups.clear();
+    for(size_t u = 0; u < program.units.size(); u++)
+    {
+        const t_unit &unit = program.units[u];
+        moved[u] = pc;
+        if( unit.removed )
+            continue;
+
+        if( unit.instruction ) {
+            uint16_t opcode = unit.opcode;
+            if( !unit.label.empty() ) {
+                opcode = opcode & 0xF000;
+                fixups.emplace_back(pc, unit.label);
+            }
+            rom[pc] = (opcode & 0xFF00) >> 8;
+            rom[pc + 1] = opcode & 0x00FF;
+        } else {
+            ::memmove(rom + pc, rom + unit.offset, unit.size);
+        }
+        pc += unit.size;
+    }
+    moved[program.units.size()] = pc;
+
+    for(auto &label : labels)
+        label.second = moved[program.unitAt[label.second]];
+
+    stats.saved = size - pc;
+    ::memset(rom + pc, 0, stats.saved);
+    size = pc;
+
+    return stats;
+}
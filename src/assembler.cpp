@@ -7,58 +7,77 @@
 #include <iostream>
 #include <cstdint>
 #include <cstring>      // ::memset
-#include <list>         // std::list
-#include <map>          // std::map
-
+#include <fstream>      // std::ofstream
+#include <filesystem>   // std::filesystem::path
+#include <iterator>     // std::istreambuf_iterator
+#include <memory>       // std::unique_ptr
 
 #include "assembler.h"
+#include "hashing.h"
+#include "object.h"
 
 #include "asm/types.h"
+#include "asm/keywords.h"
 #include "asm/parser.h"
+#include "asm/peephole.h"
 #include "asm/comphelpers.h"
 
 
-// table to hold all the jumps
-std::list<t_label> jumps_table;
+// encoder of each mnemonic, indexed by keyword: none for the special registers
+typedef uint16_t (*callback)(uint16_t, const t_token&, Parser*, t_fixups&);
+
+struct t_encoders
+{
+    callback encode[KEYWORD_COUNT];
+};
+
+static constexpr t_encoders encoders()
+{
+    t_encoders table {};
+
+    table.encode[KEYWORD_JP]   = &jumpOrCall;
+    table.encode[KEYWORD_CALL] = &jumpOrCall;
+
+    table.encode[KEYWORD_LD]   = &load;
+
+    table.encode[KEYWORD_SE]   = &skip;
+    table.encode[KEYWORD_SNE]  = &skip;
+
+    table.encode[KEYWORD_CLS]  = &misc;
+    table.encode[KEYWORD_RET]  = &misc;
+    table.encode[KEYWORD_SKP]  = &misc;
+    table.encode[KEYWORD_SKNP] = &misc;
+    table.encode[KEYWORD_RND]  = &misc;
+    table.encode[KEYWORD_DRW]  = &misc;
+
+    table.encode[KEYWORD_AND]  = &logic;
+    table.encode[KEYWORD_OR]   = &logic;
+    table.encode[KEYWORD_XOR]  = &logic;
+    table.encode[KEYWORD_SHR]  = &logic;
+    table.encode[KEYWORD_SHL]  = &logic;
 
-// mapping table between the labels name and their location in the code
-std::map<std::string, uint16_t> labels_map;
+    table.encode[KEYWORD_ADD]  = &add;
+    table.encode[KEYWORD_SUB]  = &sub;
+    table.encode[KEYWORD_SUBN] = &sub;
 
-// opcodes/byte codes functions mapping table
-typedef uint16_t (*callback)(uint16_t, t_token, Parser*);
-std::map<std::string, callback> opcodes_map;
+    return table;
+}
+
+static constexpr t_encoders ENCODERS{encoders()};
 
-extern uint16_t convert(std::string);
+// where an instruction comes from: a file read by the build and a line
+struct t_origin
+{
+    size_t file;
+    uint32_t line;
+};
+
+namespace fs = std::filesystem;
 
 
 // constructor
 Assembler::Assembler()
 {
-    // prepare the mapping table
-    opcodes_map["JP"]   = &jumpOrCall;
-    opcodes_map["CALL"] = &jumpOrCall;
-
-    opcodes_map["LD"]   = &load;
-
-    opcodes_map["SE"]   = &skip;
-    opcodes_map["SNE"]  = &skip;
-
-    opcodes_map["CLS"]  = &misc;
-    opcodes_map["RET"]  = &misc;
-    opcodes_map["SKP"]  = &misc;
-    opcodes_map["SKNP"] = &misc;
-    opcodes_map["RND"]  = &misc;
-    opcodes_map["DRW"]  = &misc;
-
-    opcodes_map["AND"]  = &logic;
-    opcodes_map["OR"]   = &logic;
-    opcodes_map["XOR"]  = &logic;
-    opcodes_map["SHR"]  = &logic;
-    opcodes_map["SHL"]  = &logic;
-
-    opcodes_map["ADD"]  = &add;
-    opcodes_map["SUB"]  = &sub;
-    opcodes_map["SUBN"] = &sub;
 }
 
 // destructor
@@ -67,19 +86,134 @@ Assembler::~Assembler()
 }
 
 
-// compile an ASM file
+// read a whole source file
+static bool readSource(const std::string &filename, std::string &content)
+{
+    std::ifstream fh(filename.c_str(), std::ios::in | std::ios::binary);
+    if( !fh.is_open() )
+        return false;
+
+    content.assign(std::istreambuf_iterator<char>(fh), std::istreambuf_iterator<char>());
+    return true;
+}
+
+
+/* Assemble a source held in memory
+ * Args:
+ *      source: the assembly source, its INCLUDE are relative to the current directory
+ * Returns:
+ *      the program, empty in case of error: getDiagnostics() tells where and why
+ */
+std::vector<uint8_t> Assembler::assemble(std::string_view source)
+{
+    name_ = "<source>";
+    files_.clear();
+    if( !build(source, nullptr) )
+        return std::vector<uint8_t>();
+
+    return std::vector<uint8_t>(ROM_, ROM_ + PC_);
+}
+
+/* Compile an ASM file into the output buffer
+ * Args:
+ *      filename: the assembly source
+ * Returns:
+ *      False in case of error, getError() tells where and why
+ */
 bool Assembler::compile(std::string filename)
 {
-    uint16_t lines{1};  // parsed lines
+    if( !load(filename, nullptr) )
+        return false;
+
+    // print the number of lines parsed
+    std::cout << lines_ << " lines parsed." << std::endl;
+    return true;
+}
+
+/* Compile an ASM file into a relocatable object, for the linker
+ * Args:
+ *      filename: the assembly source
+ *      object: receives the code, the labels and the instructions using them
+ * Returns:
+ *      False in case of error, getError() tells where and why
+ */
+bool Assembler::compileObject(std::string filename, ObjectFile &object)
+{
+    return load(filename, &object);
+}
+
+/* Read and assemble an ASM file
+ * Args:
+ *      filename: the assembly source
+ *      object: receives the relocatable object, nullptr to resolve the labels
+ * Returns:
+ *      False in case of error
+ */
+bool Assembler::load(const std::string &filename, ObjectFile *object)
+{
+    name_ = filename;
+    files_.assign(1, filename);
+
+    std::string source;
+    if( !readSource(filename, source) ) {
+        diagnostics_.clear();
+        error_.clear();
+        fail(filename, 0, "Unable to open the file.");
+        return false;
+    }
+
+    return build(source, object);
+}
+
+/* Record an error
+ * Args:
+ *      file: the source file
+ *      line: the line in this file, 0 if the error is about the whole file
+ *      message: what went wrong
+ */
+void Assembler::fail(const std::string &file, uint32_t line, std::string message)
+{
+    if( diagnostics_.empty() ) {
+        error_ = file + ":" + (line ? std::to_string(line) + ": " : std::string(" ")) + message;
+    }
 
-    // create a new parser
-    Parser* p = new (std::nothrow) Parser(filename);
-    if( p == nullptr )
-        throw std::string("Unable to allocate memory for the parser.");
+    diagnostics_.push_back(AsmDiagnostic{line, std::move(message), file});
+}
+
+/* Assemble a source into the output buffer
+ * Args:
+ *      source: the assembly source
+ *      object: receives the relocatable object, nullptr to resolve the labels
+ * Returns:
+ *      False in case of error
+ */
+bool Assembler::build(std::string_view source, ObjectFile *object)
+{
+    uint32_t lines{1};  // line of the current token
 
-    // token & output buffer
-    t_token t{TOKEN_INIT, ""};
+    // token & output buffer, nothing left from a previous compilation
+    t_token t{TOKEN_INIT, "", 1, 1};
     ::memset(ROM_, 0, MAX_MEMORY_LENGTH);
+    PC_ = 0;
+    lines_ = 0;
+    jumps_.clear();
+    labels_.clear();
+    diagnostics_.clear();
+    error_.clear();
+    optimizations_ = t_peephole();
+
+    // every file read is kept until the end, the tokens are views on them
+    std::vector<std::unique_ptr<Parser>> parsers;
+    std::vector<ObjectFile::Source> files;
+    std::vector<size_t> reading;        // files being read, the last one gives the tokens
+
+    // source file & line of each instruction, to report the unresolved labels
+    std::vector<t_origin> origin(MAX_MEMORY_LENGTH, t_origin{0, 0});
+
+    parsers.push_back(std::make_unique<Parser>(source));
+    files.push_back(ObjectFile::Source{name_, hashContent(source.data(), source.size())});
+    reading.push_back(0);
+    Parser *p = parsers.back().get();
 
     // compile the source
     try
@@ -88,26 +222,47 @@ bool Assembler::compile(std::string filename)
         {
             // retrieve the next token
             t = p->next();
+            lines = t.line;
 
-            // increment the counter on end-of-line
-            if( t.first == TOKEN_EOL ) {
-                lines++;
+            // token is a label
+            if( t.type == TOKEN_LABEL ) {
+                labels_[t.text] = PC_;
             }
 
-            // token is a label
-            if( t.first == TOKEN_LABEL ) {
-                labels_map[t.second] = PC_;
+            // the tokens now come from an included file, its path is relative to the current file
+            if( (t.type == TOKEN_OPERAND) && (t.keyword == KEYWORD_INCLUDE) ) {
+                t_token name = p->next();
+                if( name.type != TOKEN_STRING )
+                    throw std::string("INCLUDE expects a quoted file name.");
+
+                std::string path = (fs::path(files[reading.back()].path).parent_path() / name.text).string();
+                for(size_t file : reading) {
+                    if( files[file].path == path )
+                        throw std::string("Recursive INCLUDE of " + path + ".");
+                }
+
+                std::string content;
+                files_.push_back(path);
+                if( !readSource(path, content) )
+                    throw std::string("Unable to open " + path + ".");
+
+                parsers.push_back(std::make_unique<Parser>(content));
+                files.push_back(ObjectFile::Source{path, hashContent(content.data(), content.size())});
+                reading.push_back(files.size() - 1);
+                p = parsers.back().get();
+                continue;
             }
 
             // token is an operand
-            if( t.first == TOKEN_OPERAND ) {
-                // lookup for the operand in the map
-                auto it = opcodes_map.find(t.second);
+            if( t.type == TOKEN_OPERAND ) {
+                // the parser resolved the keyword, the table gives its encoder
+                callback encode = ENCODERS.encode[t.keyword];
 
                 // found it
-                if( it != opcodes_map.end()) {
+                if( encode != nullptr ) {
                     // call the function
-                    uint16_t value = (it->second)(PC_, t, p);
+                    origin[PC_] = t_origin{reading.back(), lines};
+                    uint16_t value = encode(PC_, t, p, jumps_);
 
                     // record the result in the memory buffer
                     ROM_[PC_++] = (value & 0xFF00) >> 8;
@@ -119,65 +274,105 @@ bool Assembler::compile(std::string filename)
             }
 
             // token is a series of bytes
-            if( t.first == TOKEN_BYTE ) {
+            if( t.type == TOKEN_BYTE ) {
                 // retrieve all the values associated with "DATA BYTE"
                 t_token x = p->next();
-                while( (x.first != TOKEN_EOL) && (x.first != TOKEN_END)) {
-                    uint8_t value = convert(x.second) & 0xFF;
+                while( (x.type != TOKEN_EOL) && (x.type != TOKEN_END)) {
+                    if( PC_ >= MAX_MEMORY_LENGTH )
+                        throw std::string("Maximum allowed memory reached.");
+
+                    uint8_t value = convert(x.text, 0xFF);
                     ROM_[PC_++] = value;
                     x = p->next();
                 }
-
-                // keep the lines counter accurate
-                lines++;
             }
 
-            // end of the file
-            if (t.first == TOKEN_END)
-                break;
+            // end of a file, back to the file including it
+            if (t.type == TOKEN_END) {
+                lines_ += lines - 1;
+                reading.pop_back();
+                if( reading.empty() )
+                    break;
+                p = parsers[reading.back()].get();
+            }
 
             // check if we reached the maximum allowed memory
             if( PC_ >= MAX_MEMORY_LENGTH )
                 throw std::string("Maximum allowed memory reached.");
         }
     } catch(std::string& e) {
-        std::cout << "An error occured during compilation at line " << lines << " :" << std::endl;
-        std::cout << e << std::endl;
-        delete p;
+        fail(files[reading.back()].path, lines, e);
+        return false;
+    } catch(std::exception&) {
+        fail(files[reading.back()].path, lines, "Invalid value.");
         return false;
     }
 
-    // print the number of lines parsed
-    std::cout << (lines-1) << " lines parsed." << std::endl;
+    // every label is left to the linker, which places the code
+    if( object != nullptr ) {
+        object->sources = files;
+        object->code.assign(ROM_, ROM_ + PC_);
+
+        object->symbols.clear();
+        for(const auto &label : labels_) {
+            object->symbols.push_back(ObjectFile::Symbol{std::string(label.first), label.second});
+        }
+
+        object->fixups.clear();
+        for(const auto &jump : jumps_) {
+            const t_origin &from = origin[jump.first];
+            object->fixups.push_back(ObjectFile::Fixup{jump.first, std::string(jump.second), files[from.file].path, from.line});
+        }
+
+        return true;
+    }
 
-    // resolve the jumps
-    for(auto jt = jumps_table.begin(); jt != jumps_table.end(); ++jt)
+    // resolve the jumps, every missing label is reported
+    for(auto jt = jumps_.begin(); jt != jumps_.end(); ++jt)
     {
         uint16_t offset{jt->first};
-        std::string label{jt->second};
 
         // look for the target address in the map
-        auto lm = labels_map.find(label);
+        auto lm = labels_.find(jt->second);
 
-        if( lm != labels_map.end() ) {
+        if( lm != labels_.end() ) {
             // Move the address according to the beginning of the ROM address
-            uint16_t value = lm->second + ROM_CODE_BEGIN;
-
-            // replace the placeholders
-            ROM_[offset] = ROM_[offset] | (value & 0x0F00) >> 8;
-            ROM_[offset+1] = value & 0xFF;
+            relocate(ROM_ + offset, lm->second + ROM_CODE_BEGIN);
         } else {
-            std::cout << "Cannot find label " << label << " in the source." << std::endl;
-            return false;
+            const t_origin &from = origin[offset];
+            fail(files[from.file].path, from.line, "Cannot find label " + std::string(jt->second) + " in the source.");
         }
     }
 
-    // release parser memory
-    delete p;
+    if( !diagnostics_.empty() )
+        return false;
+
+    // the peephole pass moves the code, its label references are resolved again
+    if( optimize_ ) {
+        std::vector<bool> instructions(PC_);
+        for(uint16_t offset = 0; offset < PC_; offset++)
+            instructions[offset] = (origin[offset].line != 0);
+
+        optimizations_ = peephole(ROM_, PC_, instructions, labels_, jumps_);
+        for(const auto &jump : jumps_)
+            relocate(ROM_ + jump.first, labels_.find(jump.second)->second + ROM_CODE_BEGIN);
+    }
 
     return true;
 }
 
+// return the errors of the last compilation, empty if it succeeded
+const std::vector<AsmDiagnostic>& Assembler::getDiagnostics() const
+{
+    return diagnostics_;
+}
+
+// return the first error of the last compilation, empty if it succeeded
+const std::string& Assembler::getError() const
+{
+    return error_;
+}
+
 // write the compiled code to disk
 void Assembler::write(std::string filename)
 {
@@ -190,4 +385,4 @@ void Assembler::write(std::string filename)
     }
     fh.close();
     std::cout << PC_ << " bytes generated." << std::endl;
-}
\ No newline at end of file
+}
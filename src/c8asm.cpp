@@ -3,8 +3,10 @@
  * Disassembler main
  */
 
+#include <chrono>
 #include <iostream>
 #include "assembler.h"
+#include "object.h"
 
 // semantic version
 const char* version="1.0.0";
@@ -14,7 +16,8 @@ void help()
 {
     std::cout << "Chip8 Assembler - " << version << " - aimktech" << std::endl;
     std::cout << "Syntax:" << std::endl;
-    std::cout << "    c8asm <ASM file> <output>" << std::endl;
+    std::cout << "    c8asm [-O] <ASM file> <output>    -O: peephole pass on the ROM" << std::endl;
+    std::cout << "    c8asm -c <ASM file> <object>    relocatable object for c8ld" << std::endl;
     std::cout << std::endl;
 }
 
@@ -29,11 +32,56 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    // relocatable object, the labels are resolved by c8ld
+    if( std::string(argv[1]) == "-c" ) {
+        ObjectFile object;
+        if( argc <= 3 ) {
+            help();
+            return 0;
+        }
+        if( !c8asm.compileObject(std::string(argv[2]), object) ) {
+            std::cerr << c8asm.getError() << std::endl;
+            return 1;
+        }
+        if( !object.save(std::string(argv[3])) ) {
+            std::cerr << argv[3] << ": Unable to write the object." << std::endl;
+            return 1;
+        }
+        std::cout << c8asm.getLines() << " lines parsed." << std::endl;
+        return 0;
+    }
+
+    // peephole pass
+    int first {1};
+    if( std::string(argv[1]) == "-O" ) {
+        c8asm.setOptimize(true);
+        first++;
+        if( argc <= 3 ) {
+            help();
+            return 0;
+        }
+    }
+
     try
     {
         // compile & write
-        if( c8asm.compile(std::string(argv[1])) ) {
-            c8asm.write(std::string(argv[2]));
+        auto start = std::chrono::steady_clock::now();
+        if( c8asm.compile(std::string(argv[first])) ) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if( elapsed.count() > 0 ) {
+                std::cout << static_cast<uint64_t>(c8asm.getLines() / elapsed.count()) << " lines/s." << std::endl;
+            }
+            if( first > 1 ) {
+                const t_peephole &stats = c8asm.getOptimizations();
+                std::cout << stats.threaded << " jumps threaded, " << stats.tailCalls << " tail calls, "
+                          << stats.folded << " ADD folded, " << stats.moves << " LD removed, "
+                          << stats.unreachable << " unreachable removed: "
+                          << stats.saved << " bytes saved." << std::endl;
+            }
+            c8asm.write(std::string(argv[first + 1]));
+        } else {
+            std::cerr << c8asm.getError() << std::endl;
+            return 1;
         }
     } catch(std::string &e) {
         std::cerr << "An error occurred during assembly procedure:";
@@ -0,0 +1,620 @@
+/*
+ * c8bench.cpp
+ * Benchmark suite for the interpreter, the renderer and the tools
+ */
+
+// includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <SDL2/SDL.h>
+
+#include "machine.h"
+#include "display.h"
+#include "assembler.h"
+#include "disassembler.h"
+#include "perf.h"
+#include "constants.h"
+
+// semantic version
+const char* version="1.0.0";
+
+// command line options
+struct Options
+{
+    std::string filter;
+    std::string output;
+    double minTime {0.25};      // in seconds, per benchmark
+
+    // hardware counters read around each measure, when the host allows it
+    PerfCounters *counters {nullptr};
+};
+
+// result of one benchmark
+struct Result
+{
+    std::string name;
+    std::string unit;
+    double value {0.0};
+    uint64_t operations {0};
+    double seconds {0.0};
+    std::string skipped;
+
+    // hardware events counted during the measure
+    bool counted {false};
+    uint64_t events[PerfCounters::COUNT] {0, 0, 0, 0};
+};
+
+// how a result is expressed from the operations done in a time
+enum Unit {
+    NS_PER_OP = 0,
+    US_PER_OP,
+    MILLIONS_PER_SECOND,
+    PER_SECOND
+};
+
+// help
+void help()
+{
+    std::cout << "Chip8 Benchmarks - " << version << " - aimktech" << std::endl;
+    std::cout << "Syntax:" << std::endl;
+    std::cout << "    c8bench [options]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    --filter <text>    only run the benchmarks whose name contains the text" << std::endl;
+    std::cout << "    --min-time <ms>    minimum time spent measuring each benchmark (default 250)" << std::endl;
+    std::cout << "    --output <file>    write the JSON results to a file instead of the output" << std::endl;
+    std::cout << "    --no-perf          do not read the hardware performance counters" << std::endl;
+    std::cout << std::endl;
+}
+
+/* Run a workload repeatedly until the minimum time elapsed
+ * Args:
+ *      options: the command line options
+ *      name, unit, kind: how the result is labelled and expressed
+ *      work: runs one round and returns the number of operations done
+ * Returns:
+ *      the result of the benchmark
+ */
+Result measure(const Options &options, const std::string &name, const std::string &unit, Unit kind,
+               const std::function<uint64_t()> &work)
+{
+    using clock = std::chrono::steady_clock;
+
+    Result result;
+    result.name = name;
+    result.unit = unit;
+
+    // warm-up round, fills the caches and the predecoded slots
+    work();
+
+    PerfCounters *counters = options.counters;
+    if( counters != nullptr )
+        counters->start();
+
+    auto begin = clock::now();
+    do {
+        result.operations += work();
+        result.seconds = std::chrono::duration<double>(clock::now() - begin).count();
+    } while( result.seconds < options.minTime );
+
+    if( counters != nullptr ) {
+        counters->stop();
+        result.counted = true;
+        for(int i = 0; i < PerfCounters::COUNT; i++) {
+            result.events[i] = counters->value(static_cast<PerfCounters::Counter>(i));
+        }
+    }
+
+    double rate = result.operations / result.seconds;
+    switch(kind) {
+        case NS_PER_OP:             result.value = 1e9 / rate; break;
+        case US_PER_OP:             result.value = 1e6 / rate; break;
+        case MILLIONS_PER_SECOND:   result.value = rate / 1e6; break;
+        case PER_SECOND:            result.value = rate; break;
+    }
+
+    return result;
+}
+
+// a result for a benchmark that could not run
+Result skip(const std::string &name, const std::string &unit, const std::string &reason)
+{
+    Result result;
+    result.name = name;
+    result.unit = unit;
+    result.skipped = reason;
+    return result;
+}
+
+/* Build a program looping over a body of instructions
+ * Args:
+ *      prologue: the instructions executed once
+ *      body: the instructions repeated to fill most of the code zone
+ * Returns:
+ *      the ROM image
+ */
+std::vector<byte_t> loopRom(const std::vector<word_t> &prologue, const std::vector<word_t> &body)
+{
+    std::vector<word_t> code(prologue);
+    word_t loop = MemoryZone::CODE_BEGIN + 2 * code.size();
+
+    // leave room for the jump and some data at the end of the code zone
+    size_t room = (MemoryZone::CODE_SIZE - 512) / 2 - code.size() - 1;
+    for(size_t i = 0; i + body.size() <= room; i += body.size()) {
+        code.insert(code.end(), body.begin(), body.end());
+    }
+    code.push_back(0x1000 | loop);
+
+    std::vector<byte_t> rom;
+    for(auto opcode : code) {
+        rom.push_back(opcode >> 8);
+        rom.push_back(opcode & 0xFF);
+    }
+
+    return rom;
+}
+
+// CALL / RET pairs: a body of calls to a subroutine placed after the loop
+std::vector<byte_t> callRom()
+{
+    std::vector<byte_t> rom = loopRom({}, {0x2000});
+    word_t subroutine = MemoryZone::CODE_BEGIN + rom.size();
+
+    for(size_t i = 0; i + 2 < rom.size(); i += 2) {
+        rom[i] = 0x20 | (subroutine >> 8);
+        rom[i + 1] = subroutine & 0xFF;
+    }
+
+    rom.push_back(0x00);
+    rom.push_back(0xEE);
+    return rom;
+}
+
+// convert a list of opcodes to a ROM image
+std::vector<byte_t> rawRom(const std::vector<word_t> &code)
+{
+    std::vector<byte_t> rom;
+    for(auto opcode : code) {
+        rom.push_back(opcode >> 8);
+        rom.push_back(opcode & 0xFF);
+    }
+    return rom;
+}
+
+// synthetic programs, run as whole ROMs
+struct Program
+{
+    const char *name;
+    std::vector<word_t> code;
+};
+
+const std::vector<Program> PROGRAMS = {
+    // a digit bouncing on the screen edges, drawn at a random place too
+    { "bounce", {
+        0x6000, 0x6100, 0x6201, 0x6301,     // 200: x, y, dx, dy
+        0xA000, 0xD015, 0x8024, 0x8134,     // 208: LD I, 0 / DRW / move
+        0x303A, 0x1216, 0x62FF,             // 210: right edge
+        0x3000, 0x121C, 0x6201,             // 216: left edge
+        0x311B, 0x1222, 0x63FF,             // 21C: bottom edge
+        0x3100, 0x1228, 0x6301,             // 222: top edge
+        0xC437, 0xC51B, 0xD455,             // 228: random sprite
+        0x1208                              // 22E: loop
+    }},
+    // 8-bit Fibonacci numbers computed in a subroutine
+    { "fibonacci", {
+        0x6000, 0x6101,                     // 200: V0, V1
+        0x2210, 0x7201, 0x1204,             // 204: CALL / count / loop
+        0x0000, 0x0000, 0x0000,             // 20A: padding
+        0x8300, 0x8314, 0x8010, 0x8130,     // 210: V3 = V0 + V1 & shift
+        0x00EE                              // 218: RET
+    }},
+    // 8 bytes blocks copied with LD Vx, [I] and LD [I], Vx
+    { "memcpy", {
+        0x7A08, 0x4A80, 0x6A00,             // 200: offset in VA, wraps at 128
+        0xA300, 0xFA1E, 0xF765,             // 206: load from #300
+        0xA380, 0xFA1E, 0xF755,             // 20C: store to #380
+        0x1200                              // 212: loop
+    }}
+};
+
+// synthetic assembly source, about as long as the code zone allows
+std::string assemblySource(int &lines)
+{
+    const char *templates[] = {
+        "    LD   V%X, #%02X",
+        "    ADD  V%X, #%02X",
+        "    SE   V%X, #%02X",
+        "    SNE  V%X, #%02X",
+        "    RND  V%X, #%02X",
+    };
+    const char *registers[] = {
+        "    LD   V%X, V%X",
+        "    ADD  V%X, V%X",
+        "    XOR  V%X, V%X",
+        "    SUB  V%X, V%X",
+        "    DRW  V%X, V%X, #5",
+    };
+
+    std::ostringstream source;
+    char line[64];
+    lines = 0;
+
+    for(int block = 0; block < 80; block++)
+    {
+        source << "L" << block << ":" << std::endl;
+        lines++;
+
+        for(int i = 0; i < 8; i++) {
+            std::snprintf(line, sizeof(line), templates[(block + i) % 5], i, (block * 7 + i) & 0xFF);
+            source << line << "    ; constant" << std::endl;
+            std::snprintf(line, sizeof(line), registers[(block + i) % 5], i, (i + 3) & 0x0F);
+            source << line << std::endl;
+            lines += 2;
+        }
+
+        source << "    LD   I, L" << (block + 1) % 80 << std::endl;
+        source << "    JP   L" << (block + 1) % 80 << std::endl;
+        lines += 2;
+    }
+
+    return source.str();
+}
+
+// a temporary file removed when going out of scope
+struct TempFile
+{
+    std::string path;
+
+    explicit TempFile(const std::string &content)
+    {
+        char name[] = "/tmp/c8benchXXXXXX";
+        int fd = ::mkstemp(name);
+        if( fd < 0 )
+            return;
+
+        ::close(fd);
+        path = name;
+
+        std::ofstream fh(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        fh << content;
+    }
+
+    ~TempFile()
+    {
+        if( !path.empty() )
+            ::unlink(path.c_str());
+    }
+};
+
+// silence the standard output while the tools print their results
+struct Mute
+{
+    std::ostringstream sink;
+    std::streambuf *saved;
+
+    Mute() : saved(std::cout.rdbuf(sink.rdbuf())) { }
+    ~Mute() { std::cout.rdbuf(saved); }
+};
+
+/* Benchmark an instruction family
+ * Returns:
+ *      the host time per emulated instruction
+ */
+Result opcodeBench(const Options &options, const std::string &name, const std::vector<byte_t> &rom)
+{
+    Machine machine;
+    machine.loadRom(rom.data(), rom.size());
+    machine.powerOn();
+    machine.setSeed(1);
+
+    return measure(options, "opcode/" + name, "ns/instruction", NS_PER_OP, [&]() -> uint64_t {
+        return machine.step(100000);
+    });
+}
+
+// Benchmark every instruction family
+void opcodeBenches(const Options &options, std::vector<Result> &results)
+{
+    struct Family {
+        const char *name;
+        std::vector<word_t> prologue;
+        std::vector<word_t> body;
+    };
+
+    const std::vector<Family> families = {
+        { "alu",
+          { 0x6001, 0x6103, 0x6207, 0x630F, 0x641F, 0x653F, 0x667F, 0x67FF, 0x6811 },
+          { 0x8014, 0x8121, 0x8232, 0x8343, 0x8455, 0x8566, 0x8677, 0x878E } },
+        { "drw-1", { 0xA000, 0x600A, 0x6105 }, { 0xD011 } },
+        { "drw-8", { 0xA000, 0x600A, 0x6105 }, { 0xD018 } },
+        { "drw-15", { 0xA000, 0x600A, 0x6105 }, { 0xD01F } },
+        // I moves past the registers stored or loaded, it is set again each time
+        { "fx55-fx65", {}, { 0xAF00, 0xFF55, 0xAF00, 0xFF65 } },
+        { "skips",
+          { 0x6000, 0x6101 },
+          { 0x3000, 0x8110, 0x3001, 0x8110, 0x4000, 0x8110,
+            0x4001, 0x8110, 0x5010, 0x8110, 0x9010, 0x8110 } },
+    };
+
+    for(const auto &family : families) {
+        std::string name = std::string("opcode/") + family.name;
+        if( name.find(options.filter) != std::string::npos )
+            results.push_back(opcodeBench(options, family.name, loopRom(family.prologue, family.body)));
+    }
+
+    if( std::string("opcode/call-ret").find(options.filter) != std::string::npos )
+        results.push_back(opcodeBench(options, "call-ret", callRom()));
+}
+
+// Benchmark the synthetic programs as whole ROMs
+void romBenches(const Options &options, std::vector<Result> &results)
+{
+    for(const auto &program : PROGRAMS)
+    {
+        std::string name = std::string("rom/") + program.name;
+        if( name.find(options.filter) == std::string::npos )
+            continue;
+
+        std::vector<byte_t> rom = rawRom(program.code);
+
+        Machine machine;
+        machine.loadRom(rom.data(), rom.size());
+        machine.powerOn();
+        machine.setSeed(1);
+
+        results.push_back(measure(options, name, "MIPS", MILLIONS_PER_SECOND, [&]() -> uint64_t {
+            uint64_t count {0};
+            for(int i = 0; i < 100; i++) {
+                count += machine.runFrame(1000);
+            }
+            return count;
+        }));
+    }
+}
+
+// Benchmark the rendering of a busy screen, needs a video driver
+void renderBench(const Options &options, std::vector<Result> &results)
+{
+    const std::string name = "display/render";
+    if( name.find(options.filter) == std::string::npos )
+        return;
+
+    if( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+        results.push_back(skip(name, "us/frame", SDL_GetError()));
+        return;
+    }
+
+    try
+    {
+        std::vector<byte_t> rom = rawRom(PROGRAMS[0].code);
+
+        Machine machine;
+        machine.loadRom(rom.data(), rom.size());
+        machine.powerOn();
+        machine.setSeed(1);
+
+        // let the program fill the screen
+        for(int i = 0; i < 600; i++) {
+            machine.runFrame(Constants::CYCLES_PER_FRAME);
+        }
+
+        Display display(machine.getMMU(),
+                        MemoryDefaultValue::SCREEN_WIDTH, MemoryDefaultValue::SCREEN_HEIGHT,
+                        MemoryDefaultValue::SCREEN_XSCALE, MemoryDefaultValue::SCREEN_YSCALE);
+
+        results.push_back(measure(options, name, "us/frame", US_PER_OP, [&]() -> uint64_t {
+            for(int i = 0; i < 10; i++) {
+                display.render();
+            }
+            return 10;
+        }));
+    }
+    catch(const std::exception &e)
+    {
+        results.push_back(skip(name, "us/frame", e.what()));
+    }
+
+    SDL_Quit();
+}
+
+// Benchmark the assembler and the disassembler on a synthetic program
+void toolBenches(const Options &options, std::vector<Result> &results)
+{
+    int lines {0};
+    TempFile source(assemblySource(lines));
+    TempFile rom("");
+
+    if( source.path.empty() || rom.path.empty() ) {
+        results.push_back(skip("tools", "", "Unable to create the temporary files."));
+        return;
+    }
+
+    // the generated program, also used by the disassembler
+    bool compiled {false};
+    {
+        Mute mute;
+        Assembler assembler;
+        compiled = assembler.compile(source.path);
+        if( compiled )
+            assembler.write(rom.path);
+    }
+
+    const std::string assemble = "tools/assembler";
+    if( assemble.find(options.filter) != std::string::npos )
+    {
+        if( !compiled ) {
+            results.push_back(skip(assemble, "lines/s", "The synthetic source does not assemble."));
+        } else {
+            results.push_back(measure(options, assemble, "lines/s", PER_SECOND, [&]() -> uint64_t {
+                Mute mute;
+                Assembler assembler;
+                assembler.compile(source.path);
+                return lines;
+            }));
+        }
+    }
+
+    const std::string disassemble = "tools/disassembler";
+    if( disassemble.find(options.filter) != std::string::npos && compiled )
+    {
+        std::ifstream fh(rom.path, std::ios::in | std::ios::binary | std::ios::ate);
+        uint64_t size = fh.tellg();
+
+        results.push_back(measure(options, disassemble, "bytes/s", PER_SECOND, [&]() -> uint64_t {
+            Mute mute;
+            Disassembler disassembler;
+            disassembler.loadROM(rom.path);
+            disassembler.discover();
+            disassembler.render();
+            return size;
+        }));
+    }
+}
+
+// escape a string for JSON
+std::string quote(const std::string &text)
+{
+    std::string result("\"");
+    for(char c : text) {
+        if( c == '"' || c == '\\' )
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+/* Write the hardware events of a result, in total and per operation
+ * For the interpreter benchmarks, an operation is an emulated instruction:
+ * instructions per operation are host instructions per emulated instruction,
+ * branch misses per operation the misses per dispatch.
+ */
+void writeCounters(std::ostream &out, const Result &result, const PerfCounters &counters)
+{
+    std::string total;
+    std::string ratio;
+    for(int i = 0; i < PerfCounters::COUNT; i++)
+    {
+        auto counter = static_cast<PerfCounters::Counter>(i);
+        if( !counters.available(counter) )
+            continue;
+
+        std::ostringstream value;
+        value << std::setprecision(6) << static_cast<double>(result.events[i]) / result.operations;
+
+        total += std::string(total.empty() ? "" : ", ") + quote(PerfCounters::name(counter)) + ": "
+               + std::to_string(result.events[i]);
+        ratio += std::string(ratio.empty() ? "" : ", ") + quote(PerfCounters::name(counter)) + ": "
+               + value.str();
+    }
+
+    out << ", \"counters\": {" << total << "}, \"per_operation\": {" << ratio << "}";
+}
+
+// write the results as JSON
+void writeJson(std::ostream &out, const std::vector<Result> &results, const PerfCounters *counters)
+{
+    out << "{" << std::endl;
+    out << "  \"version\": \"" << version << "\"," << std::endl;
+
+    if( counters == nullptr )
+        out << "  \"perf\": {\"available\": false, \"reason\": \"disabled\"}," << std::endl;
+    else if( !counters->available() )
+        out << "  \"perf\": {\"available\": false, \"reason\": " << quote(counters->error()) << "}," << std::endl;
+    else
+        out << "  \"perf\": {\"available\": true}," << std::endl;
+
+    out << "  \"benchmarks\": [" << std::endl;
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result &result = results[i];
+
+        out << "    {\"name\": \"" << result.name << "\", \"unit\": \"" << result.unit << "\", ";
+        if( result.skipped.empty() ) {
+            out << std::setprecision(6)
+                << "\"value\": " << result.value << ", "
+                << "\"operations\": " << result.operations << ", "
+                << "\"seconds\": " << result.seconds;
+            if( result.counted && counters->available() )
+                writeCounters(out, result, *counters);
+            out << "}";
+        } else {
+            out << "\"skipped\": " << quote(result.skipped) << "}";
+        }
+
+        out << ((i + 1 < results.size()) ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+// main entry point
+int main(int argc, char* argv[])
+{
+    Options options;
+    bool perf {true};
+
+    // parse the command line
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+
+        if( (arg == "--filter") && (i + 1 < argc) )
+            options.filter = argv[++i];
+        else if( (arg == "--min-time") && (i + 1 < argc) )
+            options.minTime = std::atoi(argv[++i]) / 1000.0;
+        else if( (arg == "--output") && (i + 1 < argc) )
+            options.output = argv[++i];
+        else if( arg == "--no-perf" )
+            perf = false;
+        else {
+            help();
+            return 0;
+        }
+    }
+
+    // counters missing on this host are reported, not an error
+    PerfCounters counters;
+    if( perf && counters.available() )
+        options.counters = &counters;
+
+    std::vector<Result> results;
+    try
+    {
+        opcodeBenches(options, results);
+        romBenches(options, results);
+        renderBench(options, results);
+        toolBenches(options, results);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    if( options.output.empty() ) {
+        writeJson(std::cout, results, perf ? &counters : nullptr);
+        return 0;
+    }
+
+    std::ofstream fh(options.output, std::ios::out | std::ios::trunc);
+    writeJson(fh, results, perf ? &counters : nullptr);
+    fh.close();
+
+    if( fh.fail() ) {
+        std::cerr << "Unable to write " << options.output << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
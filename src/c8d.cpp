@@ -0,0 +1,65 @@
+/*
+ * c8d.cpp
+ * Headless emulation server main
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "server.h"
+
+// semantic version
+const char* version="1.0.0";
+
+// default socket path
+const char* SOCKET_PATH="/tmp/c8d.sock";
+
+// help
+void help()
+{
+    std::cout << "Chip8 emulation server - " << version << " - aimktech" << std::endl;
+    std::cout << "Syntax:" << std::endl;
+    std::cout << "    c8d [options]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    --socket <path>    UNIX socket to listen on (default " << SOCKET_PATH << ")" << std::endl;
+    std::cout << "    --workers <N>      requests served in parallel (default: number of cores)" << std::endl;
+    std::cout << std::endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::string path(SOCKET_PATH);
+    int workers = std::thread::hardware_concurrency();
+
+    // parse the command line
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+
+        if( (arg == "--socket") && (i + 1 < argc) )
+            path = argv[++i];
+        else if( (arg == "--workers") && (i + 1 < argc) )
+            workers = std::atoi(argv[++i]);
+        else {
+            help();
+            return 0;
+        }
+    }
+
+    try
+    {
+        Server server(path, workers);
+
+        std::cout << "Listening on " << path << std::endl;
+        server.run();
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * c8ld.cpp
+ * Linker main
+ */
+
+#include <iostream>
+#include "assembler.h"
+#include "linker.h"
+#include "object.h"
+
+// semantic version
+const char* version="1.0.0";
+
+// help
+void help()
+{
+    std::cout << "Chip8 Linker - " << version << " - aimktech" << std::endl;
+    std::cout << "Syntax:" << std::endl;
+    std::cout << "    c8ld [options] <output> <ASM or object file>..." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    --cache <dir>    keep the objects of the ASM files, only the changed files are assembled again" << std::endl;
+    std::cout << std::endl;
+}
+
+// true if the file name ends with the suffix
+static bool endsWith(const std::string &name, const std::string &suffix)
+{
+    return (name.size() >= suffix.size()) && (name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::string cacheDirectory;
+    std::vector<std::string> files;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if( (arg == "--cache") && (i + 1 < argc) ) {
+            cacheDirectory = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    // an output and at least one input
+    if( files.size() < 2 ) {
+        help();
+        return 0;
+    }
+
+    ObjectCache cache(cacheDirectory);
+    Linker c8ld;
+
+    for(size_t i = 1; i < files.size(); i++)
+    {
+        const std::string &file = files[i];
+        ObjectFile object;
+
+        // an object produced by c8asm -c
+        if( endsWith(file, ObjectFormat::EXTENSION) ) {
+            if( !object.load(file) ) {
+                std::cerr << file << ": Invalid object file." << std::endl;
+                return 1;
+            }
+            c8ld.add(std::move(object));
+            continue;
+        }
+
+        // an unchanged source and its includes
+        if( !cacheDirectory.empty() && cache.fetch(file, object) ) {
+            std::cout << file << ": up to date." << std::endl;
+            c8ld.add(std::move(object));
+            continue;
+        }
+
+        Assembler c8asm;
+        if( !c8asm.compileObject(file, object) ) {
+            std::cerr << c8asm.getError() << std::endl;
+            return 1;
+        }
+        std::cout << file << ": " << c8asm.getLines() << " lines parsed." << std::endl;
+
+        if( !cacheDirectory.empty() && !cache.store(file, object) )
+            std::cerr << file << ": Unable to write the object in the cache." << std::endl;
+
+        c8ld.add(std::move(object));
+    }
+
+    if( !c8ld.link() ) {
+        for(const auto &diagnostic : c8ld.getDiagnostics()) {
+            std::cerr << diagnostic.file << ":";
+            if( diagnostic.line != 0 )
+                std::cerr << diagnostic.line << ":";
+            std::cerr << " " << diagnostic.message << std::endl;
+        }
+        return 1;
+    }
+
+    c8ld.write(files[0]);
+    return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * chip8.cpp
+ * C interface of the libchip8 emulation core implementation
+ */
+
+// includes
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "machine.h"
+#include "vecenv.h"
+#include "savestate.h"
+#include "constants.h"
+
+// machine handle, no exception crosses the C interface
+struct c8_machine
+{
+    std::unique_ptr<Machine> machine;
+
+    // serialized state reused by c8_snapshot
+    mutable std::vector<byte_t> state;
+
+    // owned copy, the exception giving the message is gone once caught
+    mutable std::string error;
+};
+
+// batch handle
+struct c8_vecenv
+{
+    std::unique_ptr<VecEnv> env;
+
+    // owned copy, the exception giving the message is gone once caught
+    mutable std::string error;
+};
+
+/* Record the last error of a handle, left empty if even the copy fails
+ * Args:
+ *      handle: the machine or batch handle
+ *      message: the description of the error
+ */
+template<typename Handle>
+static void fail(const Handle *handle, const char *message) noexcept
+{
+    try {
+        handle->error = message;
+    } catch(...) {
+        handle->error.clear();
+    }
+}
+
+/* Run a call on a handle, turning exceptions into an error code
+ * Args:
+ *      handle: the machine or batch handle
+ *      call: the call to run, returning its result
+ * Returns:
+ *      the result of the call, -1 if an exception was raised
+ */
+template<typename Handle, typename Call>
+static int guard(const Handle *handle, Call call)
+{
+    try {
+        return call();
+    } catch(const std::exception &e) {
+        fail(handle, e.what());
+    } catch(...) {
+        fail(handle, "Unknown error.");
+    }
+
+    return -1;
+}
+
+int c8_version(void)
+{
+    return C8_API_VERSION;
+}
+
+c8_machine* c8_create(void)
+{
+    c8_machine *handle = new (std::nothrow) c8_machine;
+    if( handle == nullptr )
+        return nullptr;
+
+    try {
+        handle->machine = std::unique_ptr<Machine>(new (std::nothrow) Machine);
+    } catch(...) {
+        // the machine failed to allocate its units
+    }
+
+    if( handle->machine == nullptr ) {
+        delete handle;
+        return nullptr;
+    }
+
+    return handle;
+}
+
+void c8_destroy(c8_machine *machine)
+{
+    delete machine;
+}
+
+const char* c8_last_error(const c8_machine *machine)
+{
+    return machine->error.c_str();
+}
+
+int c8_load_rom(c8_machine *machine, const uint8_t *rom, size_t size)
+{
+    if( size == 0 || size > MemoryZone::CODE_SIZE ) {
+        fail(machine, "Invalid ROM size.");
+        return -1;
+    }
+
+    return guard(machine, [&]() {
+        machine->machine->loadRom(rom, size);
+        machine->machine->powerOn();
+        return 0;
+    });
+}
+
+int c8_reset(c8_machine *machine)
+{
+    return guard(machine, [&]() {
+        machine->machine->powerOn();
+        return 0;
+    });
+}
+
+void c8_set_seed(c8_machine *machine, uint32_t seed)
+{
+    machine->machine->setSeed(seed);
+}
+
+int c8_step(c8_machine *machine, int cycles)
+{
+    return guard(machine, [&]() {
+        return machine->machine->step(cycles);
+    });
+}
+
+int c8_run_frame(c8_machine *machine, int cycles)
+{
+    return guard(machine, [&]() {
+        return machine->machine->runFrame(cycles);
+    });
+}
+
+void c8_set_keys(c8_machine *machine, uint16_t keys)
+{
+    machine->machine->setKeys(keys);
+}
+
+uint16_t c8_get_keys(const c8_machine *machine)
+{
+    return machine->machine->getKeys();
+}
+
+const uint8_t* c8_framebuffer(c8_machine *machine)
+{
+    return machine->machine->getMMU()->getPointer(MemoryZone::SCREEN_BEGIN);
+}
+
+size_t c8_snapshot_size(void)
+{
+    return SaveState::HEADER_SIZE + MemoryZone::TOTAL_MEMORY_SIZE;
+}
+
+int c8_snapshot(const c8_machine *machine, uint8_t *buffer, size_t size)
+{
+    return guard(machine, [&]() {
+        saveState(*machine->machine, machine->state, false);
+        if( machine->state.size() > size ) {
+            fail(machine, "Snapshot buffer is too small.");
+            return -1;
+        }
+
+        ::memcpy(buffer, machine->state.data(), machine->state.size());
+        return static_cast<int>(machine->state.size());
+    });
+}
+
+int c8_restore(c8_machine *machine, const uint8_t *buffer, size_t size)
+{
+    return guard(machine, [&]() {
+        loadState(*machine->machine, buffer, size);
+        return 0;
+    });
+}
+
+c8_vecenv* c8_vecenv_create(int count, int threads)
+{
+    if( count <= 0 )
+        return nullptr;
+
+    c8_vecenv *handle = new (std::nothrow) c8_vecenv;
+    if( handle == nullptr )
+        return nullptr;
+
+    try {
+        handle->env = std::unique_ptr<VecEnv>(new (std::nothrow) VecEnv(count, threads));
+    } catch(...) {
+        // a machine failed to allocate its units
+    }
+
+    if( handle->env == nullptr ) {
+        delete handle;
+        return nullptr;
+    }
+
+    return handle;
+}
+
+void c8_vecenv_destroy(c8_vecenv *env)
+{
+    delete env;
+}
+
+const char* c8_vecenv_last_error(const c8_vecenv *env)
+{
+    return env->error.c_str();
+}
+
+int c8_vecenv_load_rom(c8_vecenv *env, const uint8_t *rom, size_t size)
+{
+    if( size == 0 || size > MemoryZone::CODE_SIZE ) {
+        fail(env, "Invalid ROM size.");
+        return -1;
+    }
+
+    return guard(env, [&]() {
+        env->env->loadRom(rom, size);
+        return 0;
+    });
+}
+
+int c8_vecenv_reset(c8_vecenv *env, int index, uint32_t seed)
+{
+    if( index < -1 || index >= env->env->size() ) {
+        fail(env, "Invalid environment index.");
+        return -1;
+    }
+
+    return guard(env, [&]() {
+        if( index == -1 )
+            env->env->reset();
+        else
+            env->env->reset(index, seed);
+        return 0;
+    });
+}
+
+void c8_vecenv_set_cycles(c8_vecenv *env, int cycles)
+{
+    env->env->setCycles(cycles);
+}
+
+int c8_vecenv_step(c8_vecenv *env, const uint16_t *keys, int frames, uint8_t *observations)
+{
+    return guard(env, [&]() {
+        env->env->step(keys, frames, observations);
+        return 0;
+    });
+}
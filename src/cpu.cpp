@@ -5,11 +5,11 @@
 
 // includes
 #include <cstring>
-#include <cstdlib>
 #include <ctime>
 #include "constants.h"
 #include "except.h"
 #include "cpu.h"
+#include "profile.h"
 
 // constants
 constexpr int NUM_REGISTERS = 16;
@@ -18,33 +18,69 @@ enum Register {
     VF = 0x0F
 };
 
+/* predecoded slots
+ * one slot for each even address of the code zone, telling which handler
+ * executes the instruction found there (alone or fused with the next one)
+ */
+constexpr int NUM_SLOTS = MemoryZone::CODE_SIZE / 2;
+enum Slot : byte_t {
+    SLOT_EMPTY = 0,     // not decoded yet
+    SLOT_SINGLE,        // regular instruction
+    SLOT_LD_ADD,        // LD Vx, byte + ADD Vy, byte
+    SLOT_LD_ADD_REG,    // LD Vx, byte + ADD Vy, Vz
+    SLOT_LD_ADD_I,      // LD Vx, byte + ADD I, Vy
+    SLOT_SKIP_JP,       // SE/SNE + JP addr
+    SLOT_LDI_DRW,       // LD I, addr + DRW Vx, Vy, n
+    SLOT_LDDT_SE,       // LD Vx, DT + SE/SNE Vy, byte
+};
+
 // class structure
 struct CPU::OpaqueData
 {
     MMU *pMMU {nullptr};
 
-    // screen data
+    // memory & screen data
+    byte_t *pMemory {nullptr};
     byte_t *pScreen {nullptr};
     word_t screenWidth {0};
 
+    // predecoded slots & MMU generation they were decoded from
+    byte_t slots[NUM_SLOTS] {};
+    uint32_t generation {0};
+
     // CPU registers
     byte_t V[NUM_REGISTERS] {};
     word_t I {};
     word_t PC {};
     word_t SP {};
 
+    // random generator state
+    uint32_t seed {1};
+
     void create();
     void destroy();
     void reset();
 
     bool putPixel(int x, int y);
     void clearScreen();
+    void drawSprite(int x, int y, int height);
+    byte_t random();
+    void addRegister(int x, int y);
+    void addIndex(int x);
+    bool isSkipping(word_t opcode) const;
+
+    word_t fetch(word_t address) const;
+    byte_t decode(word_t address);
+    void invalidate(word_t address, int size);
+    void execute(word_t opcode);
+    int runProfiled(MemoryProfile &profile, int cycles);
 };
 
 // Initialize the structure
 void CPU::OpaqueData::create()
 {
-    // set the screen pointer
+    // set the memory & screen pointers
+    pMemory = pMMU->getPointer(0);
     pScreen = pMMU->getPointer(MemoryZone::SCREEN_BEGIN);
     screenWidth = pMMU->readW(MemoryRegister::SCREEN_WIDTH);
 
@@ -64,7 +100,15 @@ void CPU::OpaqueData::reset()
     SP = MemoryZone::STACK_END;
 
     ::memset(&V[0], 0x00, NUM_REGISTERS);
-    ::srand(::time(NULL));
+
+    // the generator never leaves 0
+    seed = static_cast<uint32_t>(::time(NULL));
+    if( seed == 0 )
+        seed = 1;
+
+    // the code may have changed since the last run
+    ::memset(&slots[0], SLOT_EMPTY, NUM_SLOTS);
+    generation = pMMU->getGeneration();
 }
 
 /* Draw a pixel on the screen
@@ -79,6 +123,7 @@ bool CPU::OpaqueData::putPixel(int x, int y)
     if( pScreen[offset] == 1 )
         isCollision = true;
 
+    pMMU->hashWrite(MemoryZone::SCREEN_BEGIN + offset, pScreen[offset], pScreen[offset] ^ 1);
     pScreen[offset] ^= 1;
 
     return isCollision;
@@ -87,191 +132,311 @@ bool CPU::OpaqueData::putPixel(int x, int y)
 // Clear the screen memory
 void CPU::OpaqueData::clearScreen()
 {
-    ::memset(pScreen, 0x00, MemoryZone::SCREEN_SIZE);
+    pMMU->fill(MemoryZone::SCREEN_BEGIN, MemoryZone::SCREEN_SIZE, 0x00);
 }
 
-/* Constructor
+/* Draw a sprite on the screen
  * Args:
- *      pMMU: the pointer to the MMU
- *      pDisplay: the pointer to the Display
+ *      x, y: the registers holding the screen coordinates
+ *      height: the number of rows of the sprite pointed by I
  */
-CPU::CPU(MMU *pMMU) :
-    data_(new (std::nothrow) OpaqueData)
+void CPU::OpaqueData::drawSprite(int x, int y, int height)
 {
-    if( data_ == nullptr ) {
-        throw CPUError("Unable to allocate CPU data.");
+    V[Register::VF] = 0;
+    for (int row = 0; row < height; row++)
+    {
+        byte_t sprite = pMMU->readB(I + row);
+        for(int col = 0; col < Constants::SPRITE_WIDTH; col++)
+        {
+            // check the upper bit only
+            if( (sprite & 0x80) > 0 )
+            {
+                // if this is true then a collision occurred
+                if( putPixel(V[x] + col, V[y] + row) )
+                    V[Register::VF] = 1;
+            }
+
+            // next bit
+            sprite <<= 1;
+        }
     }
+}
 
-    data_->pMMU = pMMU;
-    data_->create();
+/* Draw the next random byte
+ * The generator (xorshift32) is part of the CPU state so that a snapshot
+ * replays the same sequence.
+ */
+byte_t CPU::OpaqueData::random()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    return (seed >> 24);
 }
 
-// Destructor
-CPU::~CPU()
+// ADD Vx, Vy with carry in VF
+void CPU::OpaqueData::addRegister(int x, int y)
 {
-    data_->destroy();
+    int sum = V[x] + V[y];
+    V[Register::VF] = (sum > 0x00FF) ? 1 : 0;
+    V[x] = (sum & 0xFF);
 }
 
-// Reset the CPU to it's initial state
-void CPU::reset()
+// ADD I, Vx with overflow in VF
+void CPU::OpaqueData::addIndex(int x)
 {
-    data_->reset();
-    data_->clearScreen();
+    V[Register::VF] = ( (I + V[x]) > 0x0FFF ) ? 1 : 0;
+    I += V[x];
 }
 
-// Performs a Fetch/Decode/Execute cycle
-bool CPU::update()
+/* Evaluate the condition of a skip instruction (SE/SNE)
+ * Returns:
+ *      True if the next instruction has to be skipped
+ */
+bool CPU::OpaqueData::isSkipping(word_t opcode) const
 {
-    // read the next instruction
-    auto opcode = data_->pMMU->readW(data_->PC);
+    auto x = (opcode & 0x0F00) >> 8;
+    auto y = (opcode & 0x00F0) >> 4;
+    auto value = (opcode & 0x00FF);
+
+    switch(opcode & 0xF000)
+    {
+        case 0x3000: return V[x] == value;      // SE Vx, byte
+        case 0x4000: return V[x] != value;      // SNE Vx, byte
+        case 0x5000: return V[x] == V[y];       // SE Vx, Vy
+        case 0x9000: return V[x] != V[y];       // SNE Vx, Vy
+    }
+
+    return false;
+}
+
+/* Execute a batch of instructions one at a time, recording in a profile the
+ * instruction bytes executed and the stack pointer after each of them
+ * Args:
+ *      profile: the profile attached to the MMU
+ *      cycles: the number of instructions to execute
+ * Raises:
+ *      MMUError when PC leaves the memory
+ * Returns:
+ *      the number of instructions executed
+ */
+int CPU::OpaqueData::runProfiled(MemoryProfile &profile, int cycles)
+{
+    for(int count = 0; count < cycles; count++)
+    {
+        if( PC + 1 >= MemoryZone::UPPER_MEMORY_LIMIT ) {
+            throw MMUError("Address outside of memory boundaries.");
+        }
+
+        // the fetch itself is not counted as a read
+        profile.execute(PC);
+        word_t opcode = fetch(PC);
+        PC += 2;
+        execute(opcode);
+        profile.stack(SP);
+    }
+
+    return cycles;
+}
+
+// Read an opcode from the code zone without going through the MMU checks
+word_t CPU::OpaqueData::fetch(word_t address) const
+{
+    return (pMemory[address] << 8) | pMemory[address + 1];
+}
+
+/* Predecode the instruction at this address
+ * Args:
+ *      address: an even address in the code zone
+ * Returns:
+ *      the slot recorded for this address
+ */
+byte_t CPU::OpaqueData::decode(word_t address)
+{
+    byte_t slot {SLOT_SINGLE};
+    word_t first = fetch(address);
+
+    // the second instruction of a pair has to be in the code zone too
+    if( address + 2 < MemoryZone::CODE_END )
+    {
+        word_t second = fetch(address + 2);
+
+        switch(first & 0xF000)
+        {
+            case 0x6000:    // LD Vx, byte
+                if( (second & 0xF000) == 0x7000 )
+                    slot = SLOT_LD_ADD;
+                if( (second & 0xF00F) == 0x8004 )
+                    slot = SLOT_LD_ADD_REG;
+                if( (second & 0xF0FF) == 0xF01E )
+                    slot = SLOT_LD_ADD_I;
+                break;
+
+            case 0x3000:    // SE Vx, byte
+            case 0x4000:    // SNE Vx, byte
+            case 0x5000:    // SE Vx, Vy
+            case 0x9000:    // SNE Vx, Vy
+                if( (second & 0xF000) == 0x1000 )
+                    slot = SLOT_SKIP_JP;
+                break;
+
+            case 0xA000:    // LD I, addr
+                if( (second & 0xF000) == 0xD000 )
+                    slot = SLOT_LDI_DRW;
+                break;
+
+            case 0xF000:    // LD Vx, DT
+                if( ((first & 0x00FF) == 0x0007) &&
+                    (((second & 0xF000) == 0x3000) || ((second & 0xF000) == 0x4000)) )
+                    slot = SLOT_LDDT_SE;
+                break;
+        }
+    }
 
+    slots[(address - MemoryZone::CODE_BEGIN) >> 1] = slot;
+    return slot;
+}
+
+/* Drop the slots depending on a memory area written by the CPU
+ * Args:
+ *      address: the first address written
+ *      size: the number of bytes written
+ */
+void CPU::OpaqueData::invalidate(word_t address, int size)
+{
+    // the write did not reach the code zone
+    if( generation == pMMU->getGeneration() )
+        return;
+
+    // a slot covers its own instruction and the next one
+    int first = (address - 3 < MemoryZone::CODE_BEGIN) ? MemoryZone::CODE_BEGIN : address - 3;
+    int last  = (address + size - 1 > MemoryZone::CODE_END) ? MemoryZone::CODE_END : address + size - 1;
+    for(int a = first + (first & 1); a <= last; a += 2) {
+        slots[(a - MemoryZone::CODE_BEGIN) >> 1] = SLOT_EMPTY;
+    }
+
+    generation = pMMU->getGeneration();
+}
+
+/* Execute one instruction
+ * Args:
+ *      opcode: the instruction, PC already points to the next one
+ */
+void CPU::OpaqueData::execute(word_t opcode)
+{
     // retrieve values from the opcode
     auto addr = (opcode & 0x0FFF);
     auto x = (opcode & 0x0F00) >> 8;
     auto y = (opcode & 0x00F0) >> 4;
     auto value = (opcode & 0x00FF);
 
-    // incrememt PC to next instruction
-    data_->PC += 2;
-
     switch(opcode & 0xF000)
     {
         case 0x0000:
             switch(opcode)
             {
                 case 0x00E0:    // CLS
-                    data_->clearScreen();
+                    clearScreen();
                     break;
 
                 case 0x00EE:    // RET
-                    data_->PC = data_->pMMU->readW(data_->SP);
-                    data_->SP += 2;
+                    PC = pMMU->readW(SP);
+                    SP += 2;
                     break;
             }
             break;
 
         case 0x1000:    // JP addr
-            data_->PC = addr;
+            PC = addr;
             break;
 
         case 0x2000:    // CALL addr
-            data_->SP -= 2;
-            data_->pMMU->writeW(data_->SP, data_->PC);
-            data_->PC = addr;
+            SP -= 2;
+            pMMU->writeW(SP, PC);
+            invalidate(SP, 2);
+            PC = addr;
             break;
 
         case 0x3000:    // SE Vx, byte
-            if( data_->V[x] ==  value)
-                data_->PC += 2;
-            break;
-
         case 0x4000:    // SNE Vx, byte
-            if( data_->V[x] !=  value)
-                data_->PC += 2;
-            break;
-
         case 0x5000:    // SE Vx, Vy
-            if( data_->V[x] == data_->V[y] )
-                data_->PC += 2;
+            if( isSkipping(opcode) )
+                PC += 2;
             break;
 
         case 0x6000:    // LD Vx, byte
-            data_->V[x] = value;
+            V[x] = value;
             break;
 
         case 0x7000:    // ADD Vx, byte
-            data_->V[x] += value;
+            V[x] += value;
             break;
 
         case 0x8000:
             switch(opcode & 0x000F)
             {
                 case 0x0000:  // LD Vx, Vy
-                    data_->V[x] = data_->V[y];
+                    V[x] = V[y];
                     break;
 
                 case 0x0001:  // OR Vx, Vy
-                    data_->V[x] |= data_->V[y];
+                    V[x] |= V[y];
                     break;
 
                 case 0x0002:  // AND Vx, Vy
-                    data_->V[x] &= data_->V[y];
+                    V[x] &= V[y];
                     break;
 
                 case 0x0003:  // XOR Vx, Vy
-                    data_->V[x] ^= data_->V[y];
+                    V[x] ^= V[y];
                     break;
 
                 case 0x0004:  // ADC Vx, Vy
-                    {
-                        int sum = data_->V[x] + data_->V[y];
-                        data_->V[Register::VF] = (sum > 0x00FF) ? 1 : 0;
-                        data_->V[x] = (sum & 0xFF);
-                    }
+                    addRegister(x, y);
                     break;
 
                 case 0x0005:  // SBC Vx, Vy
-                    data_->V[Register::VF] = (data_->V[x] > data_->V[y]) ? 1 : 0;
-                    data_->V[x] -= data_->V[y];
+                    V[Register::VF] = (V[x] > V[y]) ? 1 : 0;
+                    V[x] -= V[y];
                     break;
 
                 case 0x0006:  // SHR Vx, 1
-                    data_->V[Register::VF] = (data_->V[x] & 0x01);
-                    data_->V[x] >>=  1;
+                    V[Register::VF] = (V[x] & 0x01);
+                    V[x] >>=  1;
                     break;
 
                 case 0x0007:  // SUBN Vx, Vy
-                    data_->V[Register::VF] = (data_->V[y] > data_->V[x]) ? 1 : 0;
-                    data_->V[x] = data_->V[y] - data_->V[x];
+                    V[Register::VF] = (V[y] > V[x]) ? 1 : 0;
+                    V[x] = V[y] - V[x];
                     break;
 
                 case 0x000E:  // SHL Vx, 1
-                    data_->V[Register::VF] = (data_->V[x] & 0x80) ? 1 : 0;
-                    data_->V[x] <<= 1;
+                    V[Register::VF] = (V[x] & 0x80) ? 1 : 0;
+                    V[x] <<= 1;
                     break;
             }
             break;
 
         case 0x9000:    // SNE Vx, Vy
-            if( data_->V[x] != data_->V[y] )
-                data_->PC += 2;
+            if( isSkipping(opcode) )
+                PC += 2;
             break;
 
         case 0xA000:    // LD I, addr
-            data_->I = addr;
+            I = addr;
             break;
 
         case 0xB000:    // JP V0, addr
-            data_->PC = addr + data_->V[Register::V0];
+            PC = addr + V[Register::V0];
             break;
 
         case 0xC000:    // RND Vx, byte
-            data_->V[x] = (::rand() % (0xFF + 1)) & value;
+            V[x] = random() & value;
             break;
 
         case 0xD000:    // DRW Vx, Vy, n
-            {
-                byte_t height = opcode & 0x000F;
-
-                data_->V[Register::VF] = 0;
-                for (int row = 0; row < height; row++)
-                {
-                    byte_t sprite = data_->pMMU->readB(data_->I + row);
-                    for(int col = 0; col < Constants::SPRITE_WIDTH; col++)
-                    {
-                        // check the upper bit only
-                        if( (sprite & 0x80) > 0 )
-                        {
-                            // if this is true then a collision occurred
-                            if( data_->putPixel(data_->V[x] + col, data_->V[y] + row) )
-                                data_->V[Register::VF] = 1;
-                        }
-
-                        // next bit
-                        sprite <<= 1;
-                    }
-                }
-            }
+            drawSprite(x, y, opcode & 0x000F);
             break;
 
         case 0xE000:
@@ -279,21 +444,21 @@ bool CPU::update()
             {
                 case 0x009E:  // SKP Vx
                     {
-                        int key = (int)data_->pMMU->readW(MemoryRegister::KEYBOARD_STATUS);
-                        int vx = 1 << data_->V[x];
+                        int key = (int)pMMU->readW(MemoryRegister::KEYBOARD_STATUS);
+                        int vx = 1 << V[x];
 
                         if( (key & vx) == vx )
-                            data_->PC += 2;
+                            PC += 2;
                     }
                     break;
 
                 case 0x00A1:  // SKNP Vx
                     {
-                        int key = (int)data_->pMMU->readW(MemoryRegister::KEYBOARD_STATUS);
-                        int vx = 1 << data_->V[x];
+                        int key = (int)pMMU->readW(MemoryRegister::KEYBOARD_STATUS);
+                        int vx = 1 << V[x];
 
                         if( (key & vx) != vx )
-                            data_->PC += 2;
+                            PC += 2;
                     }
                     break;
             }
@@ -303,14 +468,14 @@ bool CPU::update()
             switch(opcode & 0x00FF)
             {
                 case 0x0007:  // LD Vx, DT
-                    data_->V[x] = data_->pMMU->readB(MemoryRegister::DELAY_TIMER);
+                    V[x] = pMMU->readB(MemoryRegister::DELAY_TIMER);
                     break;
 
                 case 0x000A:  // LD Vx, K
                     {
-                        int key = (data_->pMMU->readW(MemoryRegister::KEYBOARD_STATUS));
+                        int key = (pMMU->readW(MemoryRegister::KEYBOARD_STATUS));
                         if( key == 0 )
-                            data_->PC -= 2;
+                            PC -= 2;
                         else
                         {
                             int vx = 1;
@@ -320,82 +485,315 @@ bool CPU::update()
                                 mask = 1 << vx;
                             }
 
-                            data_->V[x] = vx;
+                            V[x] = vx;
                         }
                     }
                     break;
 
                 case 0x0015:  // LD DT, Vx
-                    data_->pMMU->writeB(MemoryRegister::DELAY_TIMER, data_->V[x]);
+                    pMMU->writeB(MemoryRegister::DELAY_TIMER, V[x]);
                     break;
 
                 case 0x0018:  // LD ST, Vx
-                    data_->pMMU->writeB(MemoryRegister::SOUND_TIMER, data_->V[x]);
+                    pMMU->writeB(MemoryRegister::SOUND_TIMER, V[x]);
                     break;
 
                 case 0x001E:  // ADD I, VX
-                    data_->V[Register::VF] = ( (data_->I + data_->V[x]) > 0x0FFF ) ? 1 : 0;
-                    data_->I += data_->V[x];
+                    addIndex(x);
                     break;
 
                 case 0x0029:  // LD F, Vx
-                    data_->I = MemoryZone::ROM_BEGIN + (int)(data_->V[x]) * Constants::FONT_SIZE;
+                    I = MemoryZone::ROM_BEGIN + (int)(V[x]) * Constants::FONT_SIZE;
                     break;
 
                 case 0x0033:  // LD B, Vx
-                    data_->pMMU->writeB(data_->I,     (data_->V[x] / 100));
-                    data_->pMMU->writeB(data_->I + 1, (data_->V[x] / 10) % 10);
-                    data_->pMMU->writeB(data_->I + 2, (data_->V[x] % 10));
+                    pMMU->writeB(I,     (V[x] / 100));
+                    pMMU->writeB(I + 1, (V[x] / 10) % 10);
+                    pMMU->writeB(I + 2, (V[x] % 10));
+                    invalidate(I, 3);
                     break;
 
                 case 0x0055:  // LD [I], Vx
                     switch(x) {
-                        case 0x0F: data_->pMMU->writeB(data_->I + 0x0F, data_->V[0x0F]);
-                        case 0x0E: data_->pMMU->writeB(data_->I + 0x0E, data_->V[0x0E]);
-                        case 0x0D: data_->pMMU->writeB(data_->I + 0x0D, data_->V[0x0D]);
-                        case 0x0C: data_->pMMU->writeB(data_->I + 0x0C, data_->V[0x0C]);
-                        case 0x0B: data_->pMMU->writeB(data_->I + 0x0B, data_->V[0x0B]);
-                        case 0x0A: data_->pMMU->writeB(data_->I + 0x0A, data_->V[0x0A]);
-                        case 0x09: data_->pMMU->writeB(data_->I + 0x09, data_->V[0x09]);
-                        case 0x08: data_->pMMU->writeB(data_->I + 0x08, data_->V[0x08]);
-                        case 0x07: data_->pMMU->writeB(data_->I + 0x07, data_->V[0x07]);
-                        case 0x06: data_->pMMU->writeB(data_->I + 0x06, data_->V[0x06]);
-                        case 0x05: data_->pMMU->writeB(data_->I + 0x05, data_->V[0x05]);
-                        case 0x04: data_->pMMU->writeB(data_->I + 0x04, data_->V[0x04]);
-                        case 0x03: data_->pMMU->writeB(data_->I + 0x03, data_->V[0x03]);
-                        case 0x02: data_->pMMU->writeB(data_->I + 0x02, data_->V[0x02]);
-                        case 0x01: data_->pMMU->writeB(data_->I + 0x01, data_->V[0x01]);
-                        case 0x00: data_->pMMU->writeB(data_->I + 0x00, data_->V[0x00]);
+                        case 0x0F: pMMU->writeB(I + 0x0F, V[0x0F]);
+                        case 0x0E: pMMU->writeB(I + 0x0E, V[0x0E]);
+                        case 0x0D: pMMU->writeB(I + 0x0D, V[0x0D]);
+                        case 0x0C: pMMU->writeB(I + 0x0C, V[0x0C]);
+                        case 0x0B: pMMU->writeB(I + 0x0B, V[0x0B]);
+                        case 0x0A: pMMU->writeB(I + 0x0A, V[0x0A]);
+                        case 0x09: pMMU->writeB(I + 0x09, V[0x09]);
+                        case 0x08: pMMU->writeB(I + 0x08, V[0x08]);
+                        case 0x07: pMMU->writeB(I + 0x07, V[0x07]);
+                        case 0x06: pMMU->writeB(I + 0x06, V[0x06]);
+                        case 0x05: pMMU->writeB(I + 0x05, V[0x05]);
+                        case 0x04: pMMU->writeB(I + 0x04, V[0x04]);
+                        case 0x03: pMMU->writeB(I + 0x03, V[0x03]);
+                        case 0x02: pMMU->writeB(I + 0x02, V[0x02]);
+                        case 0x01: pMMU->writeB(I + 0x01, V[0x01]);
+                        case 0x00: pMMU->writeB(I + 0x00, V[0x00]);
                     }
+                    invalidate(I, x + 1);
 
-                    data_->I += x + 1;
+                    I += x + 1;
                     break;
 
                 case 0x0065:  // LD Vx, [I]
                     switch(x) {
-                        case 0x0F: data_->V[0x0F] = data_->pMMU->readB(data_->I + 0x0F);
-                        case 0x0E: data_->V[0x0E] = data_->pMMU->readB(data_->I + 0x0E);
-                        case 0x0D: data_->V[0x0D] = data_->pMMU->readB(data_->I + 0x0D);
-                        case 0x0C: data_->V[0x0C] = data_->pMMU->readB(data_->I + 0x0C);
-                        case 0x0B: data_->V[0x0B] = data_->pMMU->readB(data_->I + 0x0B);
-                        case 0x0A: data_->V[0x0A] = data_->pMMU->readB(data_->I + 0x0A);
-                        case 0x09: data_->V[0x09] = data_->pMMU->readB(data_->I + 0x09);
-                        case 0x08: data_->V[0x08] = data_->pMMU->readB(data_->I + 0x08);
-                        case 0x07: data_->V[0x07] = data_->pMMU->readB(data_->I + 0x07);
-                        case 0x06: data_->V[0x06] = data_->pMMU->readB(data_->I + 0x06);
-                        case 0x05: data_->V[0x05] = data_->pMMU->readB(data_->I + 0x05);
-                        case 0x04: data_->V[0x04] = data_->pMMU->readB(data_->I + 0x04);
-                        case 0x03: data_->V[0x03] = data_->pMMU->readB(data_->I + 0x03);
-                        case 0x02: data_->V[0x02] = data_->pMMU->readB(data_->I + 0x02);
-                        case 0x01: data_->V[0x01] = data_->pMMU->readB(data_->I + 0x01);
-                        case 0x00: data_->V[0x00] = data_->pMMU->readB(data_->I + 0x00);
+                        case 0x0F: V[0x0F] = pMMU->readB(I + 0x0F);
+                        case 0x0E: V[0x0E] = pMMU->readB(I + 0x0E);
+                        case 0x0D: V[0x0D] = pMMU->readB(I + 0x0D);
+                        case 0x0C: V[0x0C] = pMMU->readB(I + 0x0C);
+                        case 0x0B: V[0x0B] = pMMU->readB(I + 0x0B);
+                        case 0x0A: V[0x0A] = pMMU->readB(I + 0x0A);
+                        case 0x09: V[0x09] = pMMU->readB(I + 0x09);
+                        case 0x08: V[0x08] = pMMU->readB(I + 0x08);
+                        case 0x07: V[0x07] = pMMU->readB(I + 0x07);
+                        case 0x06: V[0x06] = pMMU->readB(I + 0x06);
+                        case 0x05: V[0x05] = pMMU->readB(I + 0x05);
+                        case 0x04: V[0x04] = pMMU->readB(I + 0x04);
+                        case 0x03: V[0x03] = pMMU->readB(I + 0x03);
+                        case 0x02: V[0x02] = pMMU->readB(I + 0x02);
+                        case 0x01: V[0x01] = pMMU->readB(I + 0x01);
+                        case 0x00: V[0x00] = pMMU->readB(I + 0x00);
                     }
 
-                    data_->I += x + 1;
+                    I += x + 1;
                     break;
             }
             break;
     }
 
+}
+
+/* Constructor
+ * Args:
+ *      pMMU: the pointer to the MMU
+ *      pDisplay: the pointer to the Display
+ */
+CPU::CPU(MMU *pMMU) :
+    data_(new (std::nothrow) OpaqueData, Release{true})
+{
+    if( data_ == nullptr ) {
+        throw CPUError("Unable to allocate CPU data.");
+    }
+
+    data_->pMMU = pMMU;
+    data_->create();
+}
+
+/* Constructor over a storage provided by the caller, e.g. a pool
+ * Args:
+ *      pMMU: the pointer to the MMU
+ *      storage: storageSize() bytes aligned for any type, outliving the CPU
+ */
+CPU::CPU(MMU *pMMU, void *storage) :
+    data_(new (storage) OpaqueData, Release{false})
+{
+    data_->pMMU = pMMU;
+    data_->create();
+}
+
+// Destructor
+CPU::~CPU()
+{
+    data_->destroy();
+}
+
+// Return the size of the storage holding the CPU data
+size_t CPU::storageSize()
+{
+    return sizeof(OpaqueData);
+}
+
+// Release the CPU data according to where it lives
+void CPU::Release::operator()(OpaqueData *data) const
+{
+    if( owned )
+        delete data;
+    else
+        data->~OpaqueData();
+}
+
+// Reset the CPU to it's initial state
+void CPU::reset()
+{
+    data_->reset();
+    data_->clearScreen();
+}
+
+/* Set the state of the random generator
+ * Args:
+ *      seed: the new state, 0 is replaced by 1 as the generator never leaves 0
+ */
+void CPU::setSeed(uint32_t seed)
+{
+    data_->seed = (seed != 0) ? seed : 1;
+}
+
+// Performs a Fetch/Decode/Execute cycle
+bool CPU::update()
+{
+    // read the next instruction
+    auto opcode = data_->pMMU->readW(data_->PC);
+
+    // incrememt PC to next instruction
+    data_->PC += 2;
+
+    data_->execute(opcode);
+
     return true;
 }
+
+/* Save the CPU registers into a snapshot
+ * Args:
+ *      snapshot: the destination snapshot
+ */
+void CPU::saveState(Snapshot &snapshot) const
+{
+    saveState(snapshot.cpu);
+}
+
+/* Save the CPU registers
+ * Args:
+ *      state: the destination registers
+ */
+void CPU::saveState(CPUState &state) const
+{
+    ::memcpy(&state.V[0], &data_->V[0], NUM_REGISTERS);
+    state.I = data_->I;
+    state.PC = data_->PC;
+    state.SP = data_->SP;
+    state.seed = data_->seed;
+}
+
+/* Restore the CPU registers from a snapshot
+ * The predecoded slots are dropped on the next run as the MMU memory
+ * is restored along with them.
+ * Args:
+ *      snapshot: the source snapshot
+ */
+void CPU::restoreState(const Snapshot &snapshot)
+{
+    restoreState(snapshot.cpu);
+}
+
+/* Restore the CPU registers
+ * Args:
+ *      state: the registers to restore
+ */
+void CPU::restoreState(const CPUState &state)
+{
+    ::memcpy(&data_->V[0], &state.V[0], NUM_REGISTERS);
+    data_->I = state.I;
+    data_->PC = state.PC;
+    data_->SP = state.SP;
+    data_->seed = state.seed;
+}
+
+/* Execute a batch of instructions
+ * Consecutive instructions found in the predecoded slots are executed by a
+ * single handler when the batch leaves room for both of them.
+ * Args:
+ *      cycles: the maximum number of instructions to execute
+ * Returns:
+ *      the number of instructions executed
+ */
+int CPU::run(int cycles)
+{
+    OpaqueData *d = data_.get();
+
+    // every instruction has to be seen by the profile
+    MemoryProfile *profile = d->pMMU->getProfile();
+    if( profile != nullptr )
+        return d->runProfiled(*profile, cycles);
+
+    // the code zone was modified outside of the CPU
+    if( d->generation != d->pMMU->getGeneration() ) {
+        ::memset(&d->slots[0], SLOT_EMPTY, NUM_SLOTS);
+        d->generation = d->pMMU->getGeneration();
+    }
+
+    int count {0};
+    while( count < cycles )
+    {
+        word_t pc = d->PC;
+
+        // only the even addresses of the code zone are predecoded
+        if( (pc & 1) || (pc < MemoryZone::CODE_BEGIN) || (pc >= MemoryZone::CODE_END) ) {
+            update();
+            count++;
+            continue;
+        }
+
+        byte_t slot = d->slots[(pc - MemoryZone::CODE_BEGIN) >> 1];
+        if( slot == SLOT_EMPTY )
+            slot = d->decode(pc);
+
+        word_t first = d->fetch(pc);
+
+        // single instruction, or no room left in the batch for a pair
+        if( (slot == SLOT_SINGLE) || (cycles - count < 2) ) {
+            d->PC += 2;
+            d->execute(first);
+            count++;
+            continue;
+        }
+
+        word_t second = d->fetch(pc + 2);
+        auto x = (first & 0x0F00) >> 8;
+        auto y = (second & 0x0F00) >> 8;
+        auto z = (second & 0x00F0) >> 4;
+
+        switch(slot)
+        {
+            case SLOT_LD_ADD:       // LD Vx, byte + ADD Vy, byte
+                d->V[x] = first & 0x00FF;
+                d->V[y] += second & 0x00FF;
+                d->PC += 4;
+                count += 2;
+                break;
+
+            case SLOT_LD_ADD_REG:   // LD Vx, byte + ADD Vy, Vz
+                d->V[x] = first & 0x00FF;
+                d->addRegister(y, z);
+                d->PC += 4;
+                count += 2;
+                break;
+
+            case SLOT_LD_ADD_I:     // LD Vx, byte + ADD I, Vy
+                d->V[x] = first & 0x00FF;
+                d->addIndex(y);
+                d->PC += 4;
+                count += 2;
+                break;
+
+            case SLOT_SKIP_JP:      // SE/SNE + JP addr
+                // the jump is only executed when it is not skipped
+                if( d->isSkipping(first) ) {
+                    d->PC += 4;
+                    count += 1;
+                } else {
+                    d->PC = second & 0x0FFF;
+                    count += 2;
+                }
+                break;
+
+            case SLOT_LDI_DRW:      // LD I, addr + DRW Vx, Vy, n
+                d->I = first & 0x0FFF;
+                d->PC += 4;
+                d->drawSprite(y, z, second & 0x000F);
+                count += 2;
+                break;
+
+            case SLOT_LDDT_SE:      // LD Vx, DT + SE/SNE Vy, byte
+                d->V[x] = d->pMemory[MemoryRegister::DELAY_TIMER];
+                d->PC += 4;
+                if( d->isSkipping(second) )
+                    d->PC += 2;
+                count += 2;
+                break;
+        }
+    }
+
+    return count;
+}
\ No newline at end of file
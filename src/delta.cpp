@@ -0,0 +1,89 @@
+/*
+ * delta.cpp
+ * XOR/RLE delta encoding implementation
+ */
+
+// includes
+#include "delta.h"
+
+// constants
+constexpr int MAX_RUN_LENGTH = 0x80;
+constexpr byte_t LITERAL_FLAG = 0x80;
+
+/* Encode the delta between two images
+ * Args:
+ *      base: the reference image
+ *      image: the new image
+ *      size: the size of both images
+ *      delta: the output buffer, the delta is appended to it
+ */
+void deltaEncode(const byte_t *base, const byte_t *image, int size, std::vector<byte_t> &delta)
+{
+    int offset {0};
+
+    while( offset < size )
+    {
+        // run of identical bytes
+        int length {0};
+        while( (offset + length < size) && (length < MAX_RUN_LENGTH) &&
+               (base[offset + length] == image[offset + length]) )
+            length++;
+
+        if( length > 0 ) {
+            delta.push_back(length - 1);
+            offset += length;
+            continue;
+        }
+
+        // run of different bytes
+        while( (offset + length < size) && (length < MAX_RUN_LENGTH) &&
+               (base[offset + length] != image[offset + length]) )
+            length++;
+
+        delta.push_back(LITERAL_FLAG | (length - 1));
+        for(int i = 0; i < length; i++) {
+            delta.push_back(base[offset + i] ^ image[offset + i]);
+        }
+        offset += length;
+    }
+}
+
+/* Apply a delta onto an image
+ * Args:
+ *      delta: the encoded delta
+ *      length: the size of the encoded delta
+ *      image: the image to update in place
+ *      size: the size of the image
+ * Returns:
+ *      false if the delta is corrupted or does not cover exactly the image
+ */
+bool deltaApply(const byte_t *delta, int length, byte_t *image, int size)
+{
+    int offset {0};
+    int position {0};
+
+    while( position < length )
+    {
+        byte_t control = delta[position++];
+        int count = (control & ~LITERAL_FLAG) + 1;
+
+        if( offset + count > size )
+            return false;
+
+        // unchanged bytes
+        if( (control & LITERAL_FLAG) == 0 ) {
+            offset += count;
+            continue;
+        }
+
+        // changed bytes
+        if( position + count > length )
+            return false;
+
+        for(int i = 0; i < count; i++) {
+            image[offset++] ^= delta[position++];
+        }
+    }
+
+    return (offset == size);
+}
@@ -9,6 +9,9 @@
 #include "except.h"
 #include "constants.h"
 
+// default window title
+static const char* WINDOW_TITLE = "Chip-8 Emulator";
+
 // Display structure
 struct Display::OpaqueData
 {
@@ -32,7 +35,7 @@ void Display::OpaqueData::create()
     int height = pMMU->readW(MemoryRegister::SCREEN_HEIGHT) * pMMU->readB(MemoryRegister::SCREEN_YSCALE);
 
     // create SDL window
-    pWindow = SDL_CreateWindow("Chip-8 Emulator",
+    pWindow = SDL_CreateWindow(WINDOW_TITLE,
                                 SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
                                 width, height,
                                 SDL_WINDOW_SHOWN);
@@ -128,3 +131,12 @@ void Display::render()
 
     SDL_RenderPresent(data_->pRenderer);
 }
+
+/* Change the window title
+ * Args:
+ *      title: the new title, empty for the default one
+ */
+void Display::setTitle(const std::string &title)
+{
+    SDL_SetWindowTitle(data_->pWindow, title.empty() ? WINDOW_TITLE : title.c_str());
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+/*
+ * library.cpp
+ * ROM library implementation
+ */
+
+// includes
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+#include "library.h"
+#include "machine.h"
+#include "mapping.h"
+#include "profile.h"
+#include "hashing.h"
+#include "constants.h"
+#include "except.h"
+
+namespace fs = std::filesystem;
+
+// first line of an index
+const std::string LIBRARY_HEADER = "# c8lib " + std::to_string(LibraryFile::VERSION);
+
+// RomLibrary structure
+struct RomLibrary::OpaqueData
+{
+    // sorted by name
+    std::vector<Entry> entries;
+
+    void analyse(Machine &machine, MemoryProfile &profile, Entry &entry, const byte_t *rom);
+};
+
+/* Run a ROM without input and record what its memory profile tells
+ * Args:
+ *      machine: the machine to run the ROM on
+ *      profile: the profile attached to its MMU
+ *      entry: the ROM, its hash & size are known
+ *      rom: the ROM content
+ */
+void RomLibrary::OpaqueData::analyse(Machine &machine, MemoryProfile &profile, Entry &entry, const byte_t *rom)
+{
+    machine.loadRom(rom, entry.size);
+    machine.powerOn();
+    profile.clear();
+
+    entry.crashFrame = -1;
+    for(int frame = 0; frame < LibraryFile::ANALYSIS_FRAMES; frame++)
+    {
+        try {
+            machine.runFrame(Constants::CYCLES_PER_FRAME);
+        } catch(const std::exception&) {
+            entry.crashFrame = frame;
+            break;
+        }
+    }
+
+    entry.instructions = profile.instructions();
+    entry.selfModifying = profile.selfModifying().size();
+    entry.stackDepth = profile.peakDepth();
+}
+
+// Constructor
+RomLibrary::RomLibrary() :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw LibraryError("Unable to allocate memory for RomLibrary structure.");
+    }
+}
+
+// Destructor
+RomLibrary::~RomLibrary()
+{ }
+
+/* Bring the library up to date with the content of a directory
+ * Files larger than the code zone, empty files and the index itself are
+ * skipped. The entries of the files that did not change are kept as is.
+ * Args:
+ *      directory: the directory to scan, with its subdirectories
+ * Raises:
+ *      LibraryError in case of issues
+ * Returns:
+ *      the number of ROMs analysed
+ */
+int RomLibrary::scan(const std::string &directory)
+{
+    std::unordered_map<std::string, const Entry*> known;
+    for(const auto &entry : data_->entries) {
+        known[entry.name] = &entry;
+    }
+
+    std::error_code error;
+    fs::recursive_directory_iterator it(directory, error), end;
+    if( error )
+        throw LibraryError("Unable to scan the ROM directory.");
+
+    Machine machine;
+    MemoryProfile profile;
+    machine.getMMU()->setProfile(&profile);
+
+    std::vector<Entry> entries;
+    int analysed {0};
+    for(; it != end; it.increment(error))
+    {
+        if( error )
+            throw LibraryError("Unable to scan the ROM directory.");
+
+        if( !it->is_regular_file(error) || (it->path().filename() == LibraryFile::INDEX_NAME) )
+            continue;
+
+        auto size = it->file_size(error);
+        if( error || (size == 0) || (size > static_cast<uintmax_t>(MemoryZone::CODE_SIZE)) )
+            continue;
+
+        Entry entry;
+        entry.name = it->path().lexically_relative(directory).generic_string();
+        entry.size = size;
+        entry.modified = it->last_write_time(error).time_since_epoch().count();
+
+        // unchanged since the last scan
+        auto previous = known.find(entry.name);
+        if( (previous != known.end()) && (previous->second->size == entry.size)
+                                      && (previous->second->modified == entry.modified) ) {
+            entries.push_back(*previous->second);
+            continue;
+        }
+
+        Mapping rom;
+        if( !rom.map(it->path().string()) || (rom.size != entry.size) )
+            continue;
+
+        entry.hash = hashRom(rom.data, rom.size);
+        data_->analyse(machine, profile, entry, rom.data);
+        entries.push_back(entry);
+        analysed++;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.name < b.name;
+    });
+    data_->entries.swap(entries);
+
+    return analysed;
+}
+
+/* Load an index written by save()
+ * Args:
+ *      filename: the path of the index
+ * Raises:
+ *      LibraryError in case of issues
+ */
+void RomLibrary::load(const std::string &filename)
+{
+    std::ifstream fh(filename, std::ios::in);
+    if( !fh.is_open() )
+        throw LibraryError("Unable to open the ROM library index.");
+
+    std::string line;
+    if( !std::getline(fh, line) || (line != LIBRARY_HEADER) )
+        throw LibraryError("Invalid ROM library index.");
+
+    std::vector<Entry> entries;
+    while( std::getline(fh, line) )
+    {
+        if( line.empty() || (line[0] == '#') )
+            continue;
+
+        Entry entry;
+        std::istringstream fields(line);
+        int size {0};
+        fields >> std::hex >> entry.hash >> std::dec >> size >> entry.modified >> entry.instructions
+               >> entry.selfModifying >> entry.stackDepth >> entry.crashFrame;
+
+        // the name is the rest of the line and may hold spaces
+        if( !fields || (fields.get() != '\t') || !std::getline(fields, entry.name) || entry.name.empty() )
+            throw LibraryError("Invalid ROM library index.");
+        if( (size <= 0) || (size > MemoryZone::CODE_SIZE) )
+            throw LibraryError("Invalid ROM library index.");
+
+        entry.size = size;
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.name < b.name;
+    });
+    data_->entries.swap(entries);
+}
+
+/* Write the index
+ * Args:
+ *      filename: the path of the index
+ * Raises:
+ *      LibraryError in case of issues
+ */
+void RomLibrary::save(const std::string &filename) const
+{
+    std::ofstream fh(filename, std::ios::out | std::ios::trunc);
+    if( !fh.is_open() )
+        throw LibraryError("Unable to create the ROM library index.");
+
+    fh << LIBRARY_HEADER << "\n";
+    for(const auto &entry : data_->entries)
+    {
+        fh << std::hex << std::setw(8) << std::setfill('0') << entry.hash << std::dec << std::setfill(' ') << "\t"
+           << entry.size << "\t" << entry.modified << "\t" << entry.instructions << "\t"
+           << entry.selfModifying << "\t" << entry.stackDepth << "\t" << entry.crashFrame << "\t"
+           << entry.name << "\n";
+    }
+    fh.close();
+
+    if( fh.fail() )
+        throw LibraryError("Unable to write the ROM library index.");
+}
+
+/* Look a ROM up
+ * Args:
+ *      key: the name of the ROM, or its hash as 8 hexadecimal digits
+ * Returns:
+ *      the entry found, nullptr if none
+ */
+const RomLibrary::Entry* RomLibrary::find(const std::string &key) const
+{
+    const auto &entries = data_->entries;
+
+    auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const Entry &entry, const std::string &name) {
+        return entry.name < name;
+    });
+    if( (it != entries.end()) && (it->name == key) )
+        return &(*it);
+
+    if( (key.size() != 8) || (key.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) )
+        return nullptr;
+
+    uint32_t hash = std::stoul(key, nullptr, 16);
+    for(const auto &entry : entries) {
+        if( entry.hash == hash )
+            return &entry;
+    }
+
+    return nullptr;
+}
+
+// Return the ROMs of the library, sorted by name
+const std::vector<RomLibrary::Entry>& RomLibrary::entries() const
+{
+    return data_->entries;
+}
@@ -0,0 +1,129 @@
+/*
+ * linker.cpp
+ * Chip8 linker: build a ROM from relocatable objects
+ */
+
+// includes
+#include <iostream>
+#include <fstream>      // std::ofstream
+#include <map>          // std::map
+
+#include "linker.h"
+
+
+// constructor
+Linker::Linker()
+{
+}
+
+// destructor
+Linker::~Linker()
+{
+}
+
+// add the next object of the ROM
+void Linker::add(ObjectFile object)
+{
+    objects_.push_back(std::move(object));
+}
+
+/* Record an error
+ * Args:
+ *      file: the source file
+ *      line: the line in this file, 0 if the error is about the whole file
+ *      message: what went wrong
+ */
+void Linker::fail(const std::string &file, uint32_t line, std::string message)
+{
+    if( diagnostics_.empty() ) {
+        error_ = file + ":" + (line ? std::to_string(line) + ": " : std::string(" ")) + message;
+    }
+
+    diagnostics_.push_back(AsmDiagnostic{line, std::move(message), file});
+}
+
+/* Place the objects one after the other and patch every label reference
+ * Returns:
+ *      False in case of error, getDiagnostics() tells where and why
+ */
+bool Linker::link()
+{
+    ROM_.clear();
+    diagnostics_.clear();
+    error_.clear();
+
+    // address of each label and the object defining it
+    std::map<std::string, std::pair<uint16_t, size_t>> symbols;
+
+    size_t size{0};
+    for(size_t index = 0; index < objects_.size(); index++)
+    {
+        const ObjectFile &object = objects_[index];
+
+        for(const auto &symbol : object.symbols) {
+            auto defined = symbols.emplace(symbol.name, std::make_pair(ROM_CODE_BEGIN + size + symbol.offset, index));
+            if( !defined.second ) {
+                fail(object.sources.front().path, 0, "Label " + symbol.name + " is already defined in " +
+                     objects_[defined.first->second.second].sources.front().path + ".");
+            }
+        }
+
+        size += object.code.size();
+        if( size > MAX_MEMORY_LENGTH - ROM_CODE_BEGIN ) {
+            fail(object.sources.front().path, 0, "The program does not fit in the code zone.");
+            return false;
+        }
+    }
+
+    if( !diagnostics_.empty() )
+        return false;
+
+    // copy the code and resolve the jumps, every missing label is reported
+    ROM_.reserve(size);
+    for(const auto &object : objects_)
+    {
+        size_t base = ROM_.size();
+        ROM_.insert(ROM_.end(), object.code.begin(), object.code.end());
+
+        for(const auto &fixup : object.fixups) {
+            auto symbol = symbols.find(fixup.name);
+
+            if( symbol != symbols.end() ) {
+                relocate(ROM_.data() + base + fixup.offset, symbol->second.first);
+            } else {
+                fail(fixup.file, fixup.line, "Cannot find label " + fixup.name + " in the objects.");
+            }
+        }
+    }
+
+    if( !diagnostics_.empty() ) {
+        ROM_.clear();
+        return false;
+    }
+
+    return true;
+}
+
+// return the errors of the last link, empty if it succeeded
+const std::vector<AsmDiagnostic>& Linker::getDiagnostics() const
+{
+    return diagnostics_;
+}
+
+// return the first error of the last link, empty if it succeeded
+const std::string& Linker::getError() const
+{
+    return error_;
+}
+
+// write the linked code to disk
+void Linker::write(std::string filename)
+{
+    std::ofstream fh(filename.c_str(), std::ios::out|std::ios::binary);
+    if( fh.is_open() )
+    {
+        fh.write(reinterpret_cast<const char*>(ROM_.data()), ROM_.size());
+    }
+    fh.close();
+    std::cout << ROM_.size() << " bytes generated." << std::endl;
+}
@@ -0,0 +1,397 @@
+/*
+ * machine.cpp
+ * Headless Chip8 machine implementation
+ */
+
+// includes
+#include <cstring>
+#include "machine.h"
+#include "cpu.h"
+#include "hashing.h"
+#include "mapping.h"
+#include "romset.h"
+#include "constants.h"
+#include "except.h"
+
+// storage blocks are laid out on cache line boundaries
+constexpr size_t CACHE_LINE = 64;
+
+static size_t alignLine(size_t size)
+{
+    return (size + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+}
+
+// Machine structure
+struct Machine::OpaqueData
+{
+    MMU memory;
+    CPU cpu;
+
+    // pristine copy of the ROM loaded in the code zone
+    std::vector<byte_t> rom;
+
+    OpaqueData();
+    OpaqueData(byte_t *memoryStorage, void *cpuStorage);
+
+    static MMU* initMemory(MMU *target);
+};
+
+// units allocated on the heap
+Machine::OpaqueData::OpaqueData() :
+    cpu(initMemory(&memory))
+{ }
+
+// units placed in a storage provided by the caller
+Machine::OpaqueData::OpaqueData(byte_t *memoryStorage, void *cpuStorage) :
+    memory(memoryStorage),
+    cpu(initMemory(&memory), cpuStorage)
+{ }
+
+/* Initialize a machine memory, before the CPU reads the screen registers
+ * Args:
+ *      target: the memory unit to initialize
+ * Returns:
+ *      the memory unit
+ */
+MMU* Machine::OpaqueData::initMemory(MMU *target)
+{
+    // initialize the romset
+    target->loadMemory(MemoryZone::ROM_BEGIN, sizeof(romset), &romset[0]);
+
+    // default screen registers, a Display overrides them with its own values
+    target->writeW(MemoryRegister::SCREEN_WIDTH,  MemoryDefaultValue::SCREEN_WIDTH);
+    target->writeW(MemoryRegister::SCREEN_HEIGHT, MemoryDefaultValue::SCREEN_HEIGHT);
+    target->writeB(MemoryRegister::SCREEN_XSCALE, MemoryDefaultValue::SCREEN_XSCALE);
+    target->writeB(MemoryRegister::SCREEN_YSCALE, MemoryDefaultValue::SCREEN_YSCALE);
+
+    // no key pressed
+    target->writeW(MemoryRegister::KEYBOARD_STATUS, 0x0000);
+
+    return target;
+}
+
+// Constructor
+Machine::Machine() :
+    data_(new (std::nothrow) OpaqueData, Release{true})
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for Machine structure.");
+    }
+}
+
+/* Constructor over a storage provided by the caller, nothing is allocated
+ * Args:
+ *      storage: storageSize() bytes aligned on a cache line, outliving the machine
+ */
+Machine::Machine(void *storage) :
+    data_(nullptr, Release{false})
+{
+    byte_t *block = static_cast<byte_t*>(storage);
+    byte_t *memory = block + alignLine(sizeof(OpaqueData));
+    byte_t *cpu = memory + alignLine(MemoryZone::TOTAL_MEMORY_SIZE);
+
+    data_.reset(new (block) OpaqueData(memory, cpu));
+}
+
+// Destructor
+Machine::~Machine()
+{ }
+
+// Return the size of the storage holding a whole machine
+size_t Machine::storageSize()
+{
+    return alignLine(sizeof(OpaqueData))
+         + alignLine(MemoryZone::TOTAL_MEMORY_SIZE)
+         + alignLine(CPU::storageSize());
+}
+
+// Release the machine data according to where it lives
+void Machine::Release::operator()(OpaqueData *data) const
+{
+    if( owned )
+        delete data;
+    else
+        data->~OpaqueData();
+}
+
+// Reset the CPU and clear the screen
+void Machine::reset()
+{
+    data_->cpu.reset();
+}
+
+/* Bring the machine back to its power-on state with the ROM loaded
+ * Unlike reset(), the whole memory is rebuilt so that nothing left by a
+ * previous program (code, stack, timers, keys) survives.
+ */
+void Machine::powerOn()
+{
+    MMU *memory = &data_->memory;
+
+    memory->clear();
+    data_->initMemory(memory);
+    if( !data_->rom.empty() )
+        memory->loadMemory(MemoryZone::CODE_BEGIN, data_->rom.size(), data_->rom.data());
+
+    data_->cpu.reset();
+}
+
+/* Set the state of the random generator, for reproducible runs
+ * Args:
+ *      seed: the generator state
+ */
+void Machine::setSeed(uint32_t seed)
+{
+    data_->cpu.setSeed(seed);
+}
+
+/* Load a ROM in the code zone
+ * Args:
+ *      buffer: the ROM content
+ *      size: the size of the ROM
+ * Raises:
+ *      VMError if the ROM does not fit in the code zone
+ */
+void Machine::loadRom(const byte_t *buffer, word_t size)
+{
+    if( size > MemoryZone::CODE_SIZE ) {
+        throw VMError("The ROM does not fit in the code zone.");
+    }
+
+    data_->memory.loadMemory(MemoryZone::CODE_BEGIN, size, buffer);
+    data_->rom.assign(buffer, buffer + size);
+}
+
+/* Load a ROM file in the code zone
+ * The file is mapped read-only and copied straight into the memory.
+ * Args:
+ *      filename: the path to the ROM
+ * Raises:
+ *      VMError in case of issues
+ */
+void Machine::loadRom(std::string filename)
+{
+    Mapping romfile;
+
+    if( !romfile.map(filename) ) {
+        throw VMError("Unable to load the ROM.");
+    }
+
+    // checked before the size is narrowed to a word
+    if( romfile.size == 0 ) {
+        throw VMError("The ROM file is empty.");
+    }
+    if( romfile.size > static_cast<size_t>(MemoryZone::CODE_SIZE) ) {
+        throw VMError("The ROM does not fit in the code zone.");
+    }
+
+    loadRom(romfile.data, static_cast<word_t>(romfile.size));
+}
+
+/* Execute instructions
+ * Args:
+ *      cycles: the number of instructions to execute
+ * Returns:
+ *      the number of instructions executed
+ */
+int Machine::step(int cycles)
+{
+    return data_->cpu.run(cycles);
+}
+
+/* Emulate one frame: execute instructions then update the timers
+ * Args:
+ *      cycles: the number of instructions to execute
+ * Returns:
+ *      the number of instructions executed
+ */
+int Machine::runFrame(int cycles)
+{
+    int count = data_->cpu.run(cycles);
+    updateTimers();
+
+    return count;
+}
+
+// update timers, to be called at 60Hz
+void Machine::updateTimers()
+{
+    MMU *memory = &data_->memory;
+    byte_t value{0};
+
+    // update sound timer
+    value = memory->readB(MemoryRegister::SOUND_TIMER);
+    if(value > 0) {
+        value--;
+        memory->writeB(MemoryRegister::SOUND_TIMER, value);
+    }
+
+    // update delay timer
+    value = memory->readB(MemoryRegister::DELAY_TIMER);
+    if(value > 0) {
+        value--;
+        memory->writeB(MemoryRegister::DELAY_TIMER, value);
+    }
+}
+
+// Return the keyboard status (one bit per key)
+word_t Machine::getKeys() const
+{
+    return data_->memory.readW(MemoryRegister::KEYBOARD_STATUS);
+}
+
+/* Set the keyboard status
+ * Args:
+ *      keys: one bit per key, set when the key is pressed
+ */
+void Machine::setKeys(word_t keys)
+{
+    data_->memory.writeW(MemoryRegister::KEYBOARD_STATUS, keys);
+}
+
+/* Capture the full machine state
+ * Args:
+ *      snapshot: the destination snapshot
+ */
+void Machine::snapshot(Snapshot &snapshot) const
+{
+    data_->memory.saveState(snapshot);
+    data_->cpu.saveState(snapshot);
+}
+
+/* Restore the full machine state
+ * Args:
+ *      snapshot: the source snapshot
+ */
+void Machine::restore(const Snapshot &snapshot)
+{
+    restore(snapshot.cpu, &snapshot.memory[0]);
+}
+
+/* Restore the full machine state, with the memory hash it was taken with
+ * Args:
+ *      snapshot: the source snapshot
+ *      memoryHash: the value memoryHash() returned when it was taken
+ */
+void Machine::restore(const Snapshot &snapshot, uint64_t memoryHash)
+{
+    data_->memory.restoreState(&snapshot.memory[0], memoryHash);
+    data_->cpu.restoreState(snapshot.cpu);
+}
+
+/* Restore the full machine state from its parts
+ * Args:
+ *      state: the CPU registers
+ *      memory: the memory image, TOTAL_MEMORY_SIZE bytes long
+ */
+void Machine::restore(const CPUState &state, const byte_t *memory)
+{
+    data_->memory.restoreState(memory);
+    data_->cpu.restoreState(state);
+}
+
+/* Read the CPU registers
+ * Args:
+ *      state: the destination registers
+ */
+void Machine::getRegisters(CPUState &state) const
+{
+    data_->cpu.saveState(state);
+}
+
+/* Change the CPU registers, the memory is left untouched
+ * Args:
+ *      state: the registers to restore
+ */
+void Machine::setRegisters(const CPUState &state)
+{
+    data_->cpu.restoreState(state);
+}
+
+/* Maintain the memory hash incrementally, for stateHash()
+ * Args:
+ *      enabled: True to update the hash on every memory write
+ */
+void Machine::setHashing(bool enabled)
+{
+    data_->memory.setHashing(enabled);
+}
+
+// Return the hash of the memory, computed from scratch if not maintained
+uint64_t Machine::memoryHash() const
+{
+    if( data_->memory.isHashing() )
+        return data_->memory.getHash();
+
+    const byte_t *memory = data_->memory.getPointer(0);
+    uint64_t hash {0};
+    for(int i = 0; i < MemoryZone::TOTAL_MEMORY_SIZE; i++) {
+        hash += hashByte(i, memory[i]);
+    }
+
+    return hash;
+}
+
+/* Return a hash of the whole machine state: the memory (timers and keys
+ * included), the registers and the random generator state
+ */
+uint64_t Machine::stateHash() const
+{
+    CPUState state;
+    data_->cpu.saveState(state);
+
+    uint64_t low, high;
+    ::memcpy(&low, &state.V[0], sizeof(low));
+    ::memcpy(&high, &state.V[8], sizeof(high));
+
+    uint64_t hash = hashMix(memoryHash() ^ low);
+    hash = hashMix(hash ^ high);
+    hash = hashMix(hash ^ (state.I | (static_cast<uint64_t>(state.PC) << 16) | (static_cast<uint64_t>(state.SP) << 32)));
+
+    return hashMix(hash ^ state.seed);
+}
+
+/* Fork this machine
+ * Returns:
+ *      a new machine in the very same state
+ */
+std::unique_ptr<Machine> Machine::clone() const
+{
+    std::unique_ptr<Machine> machine(new (std::nothrow) Machine);
+    if( machine == nullptr )
+        throw VMError("Unable to allocate memory for the cloned Machine.");
+
+    Snapshot state;
+    snapshot(state);
+    machine->restore(state);
+    machine->data_->rom = data_->rom;
+
+    return machine;
+}
+
+// Return the ROM loaded in this machine
+const std::vector<byte_t>& Machine::getRom() const
+{
+    return data_->rom;
+}
+
+/* Build the memory image of this machine right after the ROM was loaded
+ * Args:
+ *      memory: the destination image, TOTAL_MEMORY_SIZE bytes long
+ */
+void Machine::bootImage(byte_t *memory) const
+{
+    MMU boot;
+
+    data_->initMemory(&boot);
+    if( !data_->rom.empty() )
+        boot.loadMemory(MemoryZone::CODE_BEGIN, data_->rom.size(), data_->rom.data());
+
+    ::memcpy(memory, boot.getPointer(0), MemoryZone::TOTAL_MEMORY_SIZE);
+}
+
+// Return the memory unit of this machine
+MMU* Machine::getMMU()
+{
+    return &data_->memory;
+}
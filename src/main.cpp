@@ -4,9 +4,20 @@
  */
 
 // includes
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
 #include <exception>
 #include "vm.h"
+#include "library.h"
+#include "machine.h"
+#include "movie.h"
+#include "perf.h"
+#include "profile.h"
+#include "constants.h"
+#include "except.h"
 
 // semantic version
 const char* version="1.0.0";
@@ -16,7 +27,23 @@ void help()
 {
     std::cout << "Chip8 emulator - " << version << " - aimktech" << std::endl;
     std::cout << "Syntax:" << std::endl;
-    std::cout << "    c8run <ROM file>" << std::endl;
+    std::cout << "    c8run [options] <ROM file or .asm source>" << std::endl;
+    std::cout << "    c8run [options] --library <directory> <ROM name or hash>" << std::endl;
+    std::cout << "    c8run --scan <directory>" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    --runahead <N>     display the frame N frames ahead to hide the ROM input lag" << std::endl;
+    std::cout << "    --runahead-probe   measure how many run-ahead frames fit in one frame and exit" << std::endl;
+    std::cout << "    --turbo-fps <N>    frames displayed per second in turbo mode (default 10)" << std::endl;
+    std::cout << "    --record <movie>   record the input from the power on, saved when exiting" << std::endl;
+    std::cout << "    --trace            with --record, keep a per-frame state trace to detect desyncs" << std::endl;
+    std::cout << "    --play <movie>     replay a recorded input movie" << std::endl;
+    std::cout << "    --headless         with --play, replay without display as fast as possible" << std::endl;
+    std::cout << "    --profile <file>   with --play --headless, write the memory access heatmap" << std::endl;
+    std::cout << "    --scan <directory> index the ROMs of a directory and list them" << std::endl;
+    std::cout << "    --watch            reload the ROM, or reassemble its .asm source, when it changes" << std::endl;
+    std::cout << "    --keep-input       with --watch, keep the keys held across the reloads" << std::endl;
+    std::cout << "    --library <dir>    start a ROM found in the index of a directory" << std::endl;
     std::cout << std::endl;
     std::cout << "Another Chip8 emulator written in C++." << std::endl;
     std::cout << std::endl;
@@ -29,19 +56,292 @@ void printInfo()
     std::cout << "F1  : reduce emulator speed" << std::endl;
     std::cout << "F2  : reset emulator speed" << std::endl;
     std::cout << "F3  : increase emulator speed" << std::endl;
+    std::cout << "F4  : toggle turbo mode" << std::endl;
+    std::cout << "F5  : save emulator state" << std::endl;
+    std::cout << "F9  : load emulator state" << std::endl;
     std::cout << "F10 : restart emulator" << std::endl;
+    std::cout << "BACKSPACE : rewind the emulator (hold)" << std::endl;
     std::cout << "P   : pause the emulator" << std::endl;
 }
 
+/* Measure how many run-ahead frames fit in the budget of one frame
+ * Each displayed frame costs a snapshot, N headless frames and a restore.
+ * Args:
+ *      filename: the ROM to measure
+ */
+void probeRunAhead(std::string filename)
+{
+    using clock = std::chrono::steady_clock;
+    const int rounds = 10000;
+    const double budget = 1000000.0 / Constants::FRAMES_PER_SECOND;    // in us
+
+    Machine machine;
+    loadProgram(machine, filename);
+
+    // let the ROM boot
+    for(int i = 0; i < Constants::FRAMES_PER_SECOND; i++) {
+        machine.runFrame(Constants::CYCLES_PER_FRAME);
+    }
+
+    // snapshot & restore cost
+    Snapshot present;
+    auto begin = clock::now();
+    for(int i = 0; i < rounds; i++) {
+        machine.snapshot(present);
+        machine.restore(present);
+    }
+    double state = std::chrono::duration<double, std::micro>(clock::now() - begin).count() / rounds;
+
+    std::cout << "Run-ahead probe for " << filename << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "    snapshot + restore : " << state << " us" << std::endl;
+
+    // frame cost at the lowest and highest speeds
+    for(int speed : {1, 20})
+    {
+        int cycles = speed * Constants::CYCLES_PER_FRAME;
+
+        machine.snapshot(present);
+        begin = clock::now();
+        for(int i = 0; i < rounds; i++) {
+            machine.runFrame(cycles);
+        }
+        double frame = std::chrono::duration<double, std::micro>(clock::now() - begin).count() / rounds;
+        machine.restore(present);
+
+        std::cout << "    speed " << std::setw(2) << speed
+                  << " (" << std::setw(3) << cycles << " cycles/frame) : "
+                  << frame << " us/frame, "
+                  << static_cast<long>((budget - state) / frame)
+                  << " run-ahead frames in " << budget / 1000.0 << " ms" << std::endl;
+    }
+}
+
+/* Replay a movie without display, as fast as possible
+ * A traced movie is checked frame by frame and the playback stops at the
+ * first desync.
+ * Args:
+ *      filename: the ROM the movie was recorded with
+ *      moviefile: the movie to replay
+ *      profilefile: if not empty, the memory access heatmap to write
+ * Returns:
+ *      False if the playback diverged from the recording
+ */
+bool playHeadless(std::string filename, std::string moviefile, std::string profilefile)
+{
+    using clock = std::chrono::steady_clock;
+
+    Machine machine;
+    loadProgram(machine, filename);
+
+    Movie movie;
+    movie.load(moviefile);
+    movie.startPlayback(machine);
+
+    // per-address accesses, counted from the power on
+    MemoryProfile profile;
+    if( !profilefile.empty() )
+        machine.getMMU()->setProfile(&profile);
+
+    // hardware events of the emulation, when the host provides them
+    PerfCounters counters;
+    uint64_t instructions {0};
+
+    int cycles {0};
+    counters.start();
+    auto begin = clock::now();
+    while( movie.playFrame(machine, cycles) )
+    {
+        instructions += machine.runFrame(cycles);
+
+        if( !movie.verifyFrame(machine) ) {
+            std::cout << movie.getDivergence();
+            return false;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+    counters.stop();
+
+    double fps = movie.frames() / std::max(elapsed, 1e-9);
+    std::cout << "Played " << moviefile << (movie.hasTrace() ? " (verified)" : "") << ": "
+              << movie.frames() << " frames in "
+              << std::fixed << std::setprecision(3) << elapsed << " s, "
+              << std::setprecision(0) << fps << " frames/s (x"
+              << std::setprecision(1) << fps / Constants::FRAMES_PER_SECOND << ")" << std::endl;
+    std::cout << "Final state hash: " << std::hex << std::setw(16) << std::setfill('0')
+              << machine.stateHash() << std::dec << std::endl;
+
+    if( !profilefile.empty() ) {
+        machine.getMMU()->setProfile(nullptr);
+        profile.report(std::cout);
+        profile.save(profilefile);
+        std::cout << "Heatmap written to " << profilefile << std::endl;
+    }
+
+    if( !counters.available() ) {
+        std::cout << "Performance counters unavailable (" << counters.error() << ")" << std::endl;
+        return true;
+    }
+
+    // one dispatch per emulated instruction
+    std::cout << "Per emulated instruction:";
+    for(int i = 0; i < PerfCounters::COUNT; i++) {
+        auto counter = static_cast<PerfCounters::Counter>(i);
+        if( counters.available(counter) )
+            std::cout << " " << PerfCounters::name(counter) << " "
+                      << std::setprecision(3) << static_cast<double>(counters.value(counter)) / std::max<uint64_t>(instructions, 1);
+    }
+    std::cout << std::endl;
+
+    return true;
+}
+
+/* Bring the ROM library index of a directory up to date and list it
+ * Args:
+ *      directory: the directory holding the ROMs
+ */
+void scanLibrary(std::string directory)
+{
+    using clock = std::chrono::steady_clock;
+    std::string indexfile = directory + "/" + LibraryFile::INDEX_NAME;
+
+    // start from the previous index, only the new or modified ROMs are analysed
+    RomLibrary library;
+    try {
+        library.load(indexfile);
+    } catch(const LibraryError&) {
+        // first scan, or an index to rebuild
+    }
+
+    auto begin = clock::now();
+    int analysed = library.scan(directory);
+    double elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+    library.save(indexfile);
+
+    std::cout << "hash      size   instr/frame  smc  stack  status     name" << std::endl;
+    for(const auto &entry : library.entries())
+    {
+        std::cout << std::hex << std::setw(8) << std::setfill('0') << entry.hash << std::dec << std::setfill(' ')
+                  << "  " << std::setw(4) << entry.size
+                  << "  " << std::setw(11) << entry.instructions / LibraryFile::ANALYSIS_FRAMES
+                  << "  " << std::setw(3) << entry.selfModifying
+                  << "  " << std::setw(5) << entry.stackDepth
+                  << "  " << std::left << std::setw(9)
+                  << (entry.crashFrame < 0 ? "ok" : "crash@" + std::to_string(entry.crashFrame)) << std::right
+                  << "  " << entry.name << std::endl;
+    }
+    std::cout << library.entries().size() << " ROMs, " << analysed << " analysed in "
+              << std::fixed << std::setprecision(3) << elapsed << " s, index written to " << indexfile << std::endl;
+}
+
 // main entry point
 int main(int argc, char* argv[])
 {
-    // no arguments provided
-    if (argc == 1) {
+    std::string romfile;
+    int runahead {0};
+    int turborate {10};
+    bool probe {false};
+    bool headless {false};
+    bool trace {false};
+    bool watch {false};
+    bool keepInput {false};
+    std::string recordfile;
+    std::string playfile;
+    std::string profilefile;
+    std::string scandir;
+    std::string librarydir;
+
+    // parse the command line
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+
+        if( (arg == "--runahead") && (i + 1 < argc) )
+            runahead = std::atoi(argv[++i]);
+        else if( (arg == "--turbo-fps") && (i + 1 < argc) )
+            turborate = std::atoi(argv[++i]);
+        else if( (arg == "--record") && (i + 1 < argc) )
+            recordfile = argv[++i];
+        else if( (arg == "--play") && (i + 1 < argc) )
+            playfile = argv[++i];
+        else if( (arg == "--profile") && (i + 1 < argc) )
+            profilefile = argv[++i];
+        else if( (arg == "--scan") && (i + 1 < argc) )
+            scandir = argv[++i];
+        else if( (arg == "--library") && (i + 1 < argc) )
+            librarydir = argv[++i];
+        else if( arg == "--runahead-probe" )
+            probe = true;
+        else if( arg == "--headless" )
+            headless = true;
+        else if( arg == "--trace" )
+            trace = true;
+        else if( arg == "--watch" )
+            watch = true;
+        else if( arg == "--keep-input" )
+            keepInput = true;
+        else
+            romfile = arg;
+    }
+
+    if( !scandir.empty() ) {
+        try {
+            scanLibrary(scandir);
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    // the ROM is looked up in the index, the directory is not scanned
+    if( !librarydir.empty() && !romfile.empty() ) {
+        try {
+            RomLibrary library;
+            library.load(librarydir + "/" + LibraryFile::INDEX_NAME);
+
+            const RomLibrary::Entry *entry = library.find(romfile);
+            if( entry == nullptr ) {
+                std::cerr << "No ROM " << romfile << " in the library, run --scan " << librarydir << " first." << std::endl;
+                return 1;
+            }
+            romfile = librarydir + "/" + entry->name;
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    // no ROM provided
+    if (romfile.empty()) {
         help();
         return 0;
     }
 
+    if( probe ) {
+        try {
+            probeRunAhead(romfile);
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << '\n';
+        }
+        return 0;
+    }
+
+    if( headless && !playfile.empty() ) {
+        try {
+            return playHeadless(romfile, playfile, profilefile) ? 0 : 1;
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << '\n';
+        }
+        return 0;
+    }
+
+    // a movie only replays on the program it was recorded with
+    if( watch && (!playfile.empty() || !recordfile.empty()) ) {
+        std::cerr << "--watch cannot be used with --record or --play." << std::endl;
+        return 1;
+    }
+
     printInfo();
 
     try
@@ -50,9 +350,20 @@ int main(int argc, char* argv[])
 
         // initialize the Virtual Machine
         myVM.init();
+        myVM.setRunAhead(runahead);
+        myVM.setTurboRate(turborate);
+
+        // load the ROM, reloaded on change when watched
+        if( watch )
+            myVM.watch(romfile, keepInput);
+        else
+            myVM.loadRom(romfile);
 
-        // load the ROM
-        myVM.loadRom(argv[1]);
+        // input movie
+        if( !playfile.empty() )
+            myVM.playMovie(playfile);
+        else if( !recordfile.empty() )
+            myVM.recordMovie(recordfile, trace);
 
         // run the VM
         myVM.run();
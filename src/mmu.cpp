@@ -9,6 +9,7 @@
 #include "mmu.h"
 #include "constants.h"
 #include "except.h"
+#include "profile.h"
 
 
 /* Constructor
@@ -18,13 +19,25 @@
  *      MMUError in case of error
  */
 MMU::MMU() :
-    memory_(new (std::nothrow) byte_t [MemoryZone::TOTAL_MEMORY_SIZE])
+    owned_(new (std::nothrow) byte_t [MemoryZone::TOTAL_MEMORY_SIZE])
 {
     // memory was not allocated properly
-    if( memory_ == nullptr ) {
+    if( owned_ == nullptr ) {
         throw MMUError("Unable to allocate main memory space.");
     }
-    ::memset(memory_.get(), 0, MemoryZone::TOTAL_MEMORY_SIZE);
+
+    memory_ = owned_.get();
+    ::memset(memory_, 0, MemoryZone::TOTAL_MEMORY_SIZE);
+}
+
+/* Constructor over memory provided by the caller, e.g. a pool
+ * Args:
+ *      storage: TOTAL_MEMORY_SIZE bytes, outliving the MMU
+ */
+MMU::MMU(byte_t *storage) :
+    memory_(storage)
+{
+    ::memset(memory_, 0, MemoryZone::TOTAL_MEMORY_SIZE);
 }
 
 // destructor
@@ -48,6 +61,9 @@ byte_t MMU::readB(word_t address) const
         throw MMUError("Address outside of memory boundaries.");
     }
 
+    if( profile_ != nullptr )
+        profile_->read(address);
+
     return memory_[address];
 }
 
@@ -82,6 +98,15 @@ void MMU::writeB(word_t address, byte_t value)
         throw MMUError("Trying to write into Read Only memory.");
     }
 
+    // self-modifying code
+    if( address <= MemoryZone::CODE_END ) {
+        generation_++;
+    }
+
+    if( profile_ != nullptr )
+        profile_->write(address);
+
+    hashWrite(address, memory_[address], value);
     memory_[(int)address] = value;
 }
 
@@ -107,15 +132,59 @@ void MMU::writeW(word_t address, word_t value)
  * Raises:
  *      MMUError in case of issues
  */
-void MMU::loadMemory(word_t address, word_t size, byte_t *buffer)
+void MMU::loadMemory(word_t address, word_t size, const byte_t *buffer)
 {
     if( address + size > MemoryZone::UPPER_MEMORY_LIMIT ) {
         throw MMUError("Address outside of memory boundaries.");
     }
 
+    // new code loaded
+    if( address <= MemoryZone::CODE_END ) {
+        generation_++;
+    }
+
+    for(int i = 0; hashing_ && i < size; i++) {
+        hashWrite(address + i, memory_[address + i], buffer[i]);
+    }
+
     ::memcpy(&memory_[address], buffer, size);
 }
 
+/* Fill a memory block with a value
+ * Args:
+ *      address: the target address in memory
+ *      size: the size of the block
+ *      value: the value to write
+ * Raises:
+ *      MMUError in case of issues
+ */
+void MMU::fill(word_t address, word_t size, byte_t value)
+{
+    if( address + size > MemoryZone::UPPER_MEMORY_LIMIT ) {
+        throw MMUError("Address outside of memory boundaries.");
+    }
+
+    if( address <= MemoryZone::CODE_END ) {
+        generation_++;
+    }
+
+    for(int i = 0; hashing_ && i < size; i++) {
+        hashWrite(address + i, memory_[address + i], value);
+    }
+
+    ::memset(&memory_[address], value, size);
+}
+
+// Zero the whole memory
+void MMU::clear()
+{
+    // the code zone is erased
+    generation_++;
+
+    ::memset(memory_, 0x00, MemoryZone::TOTAL_MEMORY_SIZE);
+    rehash();
+}
+
 /* Return a pointer from a memory zone
  * Args:
  *      address: the requested memory address
@@ -131,4 +200,70 @@ byte_t* MMU::getPointer(word_t address)
     }
 
     return &memory_[address];
+}
+
+/* Copy the whole memory into a snapshot
+ * Args:
+ *      snapshot: the destination snapshot
+ */
+void MMU::saveState(Snapshot &snapshot) const
+{
+    ::memcpy(&snapshot.memory[0], memory_, MemoryZone::TOTAL_MEMORY_SIZE);
+}
+
+/* Restore the whole memory from a snapshot
+ * Args:
+ *      snapshot: the source snapshot
+ */
+void MMU::restoreState(const Snapshot &snapshot)
+{
+    restoreState(&snapshot.memory[0]);
+}
+
+/* Restore the whole memory from a memory image
+ * Args:
+ *      memory: the source image, TOTAL_MEMORY_SIZE bytes long
+ */
+void MMU::restoreState(const byte_t *memory)
+{
+    // the code zone may differ
+    generation_++;
+
+    ::memcpy(memory_, memory, MemoryZone::TOTAL_MEMORY_SIZE);
+    rehash();
+}
+
+/* Restore the whole memory from a memory image whose hash is known
+ * Args:
+ *      memory: the source image, TOTAL_MEMORY_SIZE bytes long
+ *      hash: the value getHash() returned for this image
+ */
+void MMU::restoreState(const byte_t *memory, uint64_t hash)
+{
+    generation_++;
+
+    ::memcpy(memory_, memory, MemoryZone::TOTAL_MEMORY_SIZE);
+    hash_ = hash;
+}
+
+/* Enable or disable the incremental memory hash
+ * Args:
+ *      enabled: True to maintain the hash on every write
+ */
+void MMU::setHashing(bool enabled)
+{
+    hashing_ = enabled;
+    rehash();
+}
+
+// Compute the memory hash from scratch
+void MMU::rehash()
+{
+    if( !hashing_ )
+        return;
+
+    hash_ = 0;
+    for(int i = 0; i < MemoryZone::TOTAL_MEMORY_SIZE; i++) {
+        hash_ += hashByte(i, memory_[i]);
+    }
 }
\ No newline at end of file
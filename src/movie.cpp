@@ -0,0 +1,546 @@
+/*
+ * movie.cpp
+ * Input movies implementation
+ */
+
+// includes
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "movie.h"
+#include "binary.h"
+#include "hashing.h"
+#include "constants.h"
+#include "except.h"
+
+// file signature
+const char MOVIE_MAGIC[4] = { 'C', '8', 'M', 'V' };
+
+// event types
+enum EventType {
+    EVENT_KEYS = 0,
+    EVENT_CYCLES,
+    EVENT_RESET
+};
+
+// an input change, applied before the frame it belongs to
+struct Event
+{
+    uint32_t frame;
+    int type;
+    uint32_t value;
+};
+
+// state reached at the end of a frame, for the traced movies
+struct FrameTrace
+{
+    uint32_t hash {0};
+    CPUState cpu {};
+    byte_t delay {0};
+    byte_t sound {0};
+};
+
+// fields of a trace, in the order of the change mask
+constexpr int TRACE_FIELDS = 22;
+const char *FIELD_NAMES[TRACE_FIELDS] = {
+    "V0", "V1", "V2", "V3", "V4", "V5", "V6", "V7",
+    "V8", "V9", "VA", "VB", "VC", "VD", "VE", "VF",
+    "I", "PC", "SP", "DT", "ST", "seed"
+};
+const int FIELD_SIZES[TRACE_FIELDS] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 1, 1, 4
+};
+
+// Movie structure
+struct Movie::OpaqueData
+{
+    uint32_t romHash {0};
+    uint32_t seed {1};
+    uint32_t frames {0};
+    int cycles {Constants::CYCLES_PER_FRAME};
+    std::vector<Event> events;
+
+    // per-frame states, empty if the movie is not traced
+    bool trace {false};
+    std::vector<FrameTrace> states;
+
+    // recording: last values logged
+    word_t keys {0};
+    int lastCycles {0};
+
+    // playback: next event & current instructions per frame
+    size_t next {0};
+    uint32_t frame {0};
+    int playCycles {0};
+
+    // verification: first frame diverging from the recording
+    bool diverged {false};
+    std::string divergence;
+};
+
+// value of a field of a trace
+static uint32_t getField(const FrameTrace &trace, int field)
+{
+    if( field < 16 )
+        return trace.cpu.V[field];
+
+    switch(field)
+    {
+        case 16: return trace.cpu.I;
+        case 17: return trace.cpu.PC;
+        case 18: return trace.cpu.SP;
+        case 19: return trace.delay;
+        case 20: return trace.sound;
+        default: return trace.cpu.seed;
+    }
+}
+
+// set a field of a trace
+static void setField(FrameTrace &trace, int field, uint32_t value)
+{
+    if( field < 16 ) {
+        trace.cpu.V[field] = value;
+        return;
+    }
+
+    switch(field)
+    {
+        case 16: trace.cpu.I = value; break;
+        case 17: trace.cpu.PC = value; break;
+        case 18: trace.cpu.SP = value; break;
+        case 19: trace.delay = value; break;
+        case 20: trace.sound = value; break;
+        default: trace.cpu.seed = value; break;
+    }
+}
+
+// capture the state of a machine at the end of a frame
+static void captureTrace(Machine &machine, FrameTrace &trace)
+{
+    MMU *memory = machine.getMMU();
+
+    machine.getRegisters(trace.cpu);
+    trace.delay = memory->readB(MemoryRegister::DELAY_TIMER);
+    trace.sound = memory->readB(MemoryRegister::SOUND_TIMER);
+    trace.hash = static_cast<uint32_t>(machine.stateHash());
+}
+
+// append an unsigned LEB128 integer
+static void putVarint(std::vector<byte_t> &buffer, uint32_t value)
+{
+    while( value >= 0x80 ) {
+        buffer.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buffer.push_back(value);
+}
+
+// read an unsigned LEB128 integer, False when truncated or too long
+static bool getVarint(const byte_t *&data, const byte_t *end, uint32_t &value)
+{
+    value = 0;
+    for(int shift = 0; shift < 32; shift += 7)
+    {
+        if( data == end )
+            return false;
+
+        byte_t current = *data++;
+        value |= static_cast<uint32_t>(current & 0x7F) << shift;
+        if( (current & 0x80) == 0 )
+            return true;
+    }
+
+    return false;
+}
+
+// Constructor
+Movie::Movie() :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw MovieError("Unable to allocate memory for Movie structure.");
+    }
+}
+
+// Destructor
+Movie::~Movie()
+{ }
+
+/* Start a new recording, the machine is powered on
+ * Args:
+ *      machine: the machine to record, with its ROM loaded
+ *      cycles: the instructions per frame at the start
+ *      trace: keep the state reached by each frame, to check the playback
+ */
+void Movie::startRecording(Machine &machine, int cycles, bool trace)
+{
+    machine.powerOn();
+    machine.setHashing(trace);
+
+    CPUState state;
+    machine.getRegisters(state);
+
+    data_->romHash = hashRom(machine.getRom());
+    data_->seed = state.seed;
+    data_->frames = 0;
+    data_->cycles = cycles;
+    data_->events.clear();
+    data_->trace = trace;
+    data_->states.clear();
+
+    data_->keys = machine.getKeys();
+    data_->lastCycles = cycles;
+}
+
+/* Log the input of the frame about to be emulated
+ * Args:
+ *      machine: the recorded machine
+ *      cycles: the instructions per frame used for this frame
+ */
+void Movie::recordFrame(const Machine &machine, int cycles)
+{
+    OpaqueData *d = data_.get();
+
+    word_t keys = machine.getKeys();
+    if( keys != d->keys ) {
+        d->events.push_back(Event{d->frames, EVENT_KEYS, keys});
+        d->keys = keys;
+    }
+
+    if( cycles != d->lastCycles ) {
+        d->events.push_back(Event{d->frames, EVENT_CYCLES, static_cast<uint32_t>(cycles)});
+        d->lastCycles = cycles;
+    }
+
+    d->frames++;
+}
+
+/* Keep the state reached at the end of the frame just emulated
+ * Args:
+ *      machine: the recorded machine
+ */
+void Movie::recordState(Machine &machine)
+{
+    if( !data_->trace )
+        return;
+
+    data_->states.emplace_back();
+    captureTrace(machine, data_->states.back());
+}
+
+/* Log a reset of the recorded machine, which drew a new random seed
+ * Args:
+ *      machine: the machine just reset
+ */
+void Movie::recordReset(const Machine &machine)
+{
+    CPUState state;
+    machine.getRegisters(state);
+
+    data_->events.push_back(Event{data_->frames, EVENT_RESET, state.seed});
+}
+
+/* Power a machine on in the state the movie starts from
+ * Args:
+ *      machine: the machine to play the movie on, with its ROM loaded
+ * Raises:
+ *      MovieError if the movie was recorded with another ROM
+ */
+void Movie::startPlayback(Machine &machine)
+{
+    if( hashRom(machine.getRom()) != data_->romHash )
+        throw MovieError("Movie was recorded with a different ROM.");
+
+    machine.powerOn();
+    machine.setSeed(data_->seed);
+    machine.setHashing(data_->trace);
+
+    data_->next = 0;
+    data_->frame = 0;
+    data_->playCycles = data_->cycles;
+    data_->diverged = false;
+    data_->divergence.clear();
+}
+
+/* Apply the input of the next frame of the movie
+ * Args:
+ *      machine: the machine the movie is played on
+ *      cycles: receives the instructions per frame to emulate this frame
+ * Returns:
+ *      False once every frame of the movie was played
+ */
+bool Movie::playFrame(Machine &machine, int &cycles)
+{
+    OpaqueData *d = data_.get();
+
+    if( d->frame >= d->frames )
+        return false;
+
+    while( d->next < d->events.size() && d->events[d->next].frame == d->frame )
+    {
+        const Event &event = d->events[d->next++];
+        switch(event.type)
+        {
+            case EVENT_KEYS:
+                machine.setKeys(event.value);
+                break;
+
+            case EVENT_CYCLES:
+                d->playCycles = event.value;
+                break;
+
+            case EVENT_RESET:
+                machine.reset();
+                machine.setSeed(event.value);
+                break;
+        }
+    }
+
+    cycles = d->playCycles;
+    d->frame++;
+
+    return true;
+}
+
+/* Compare the state reached by the frame just played with the recording
+ * Args:
+ *      machine: the machine the movie is played on
+ * Returns:
+ *      False at the first frame diverging from the recording, described by
+ *      getDivergence(), the following frames are not checked
+ */
+bool Movie::verifyFrame(Machine &machine)
+{
+    OpaqueData *d = data_.get();
+
+    if( !d->trace || d->diverged || d->frame == 0 || d->frame > d->states.size() )
+        return true;
+
+    const FrameTrace &expected = d->states[d->frame - 1];
+    FrameTrace actual;
+    captureTrace(machine, actual);
+
+    if( actual.hash == expected.hash )
+        return true;
+
+    std::ostringstream report;
+    report << std::hex << std::setfill('0');
+    report << "Desync at frame " << std::dec << d->frame - 1 << std::hex
+           << ": state hash 0x" << std::setw(8) << actual.hash
+           << ", recorded 0x" << std::setw(8) << expected.hash << std::endl;
+
+    bool registers {false};
+    for(int field = 0; field < TRACE_FIELDS; field++)
+    {
+        if( getField(actual, field) == getField(expected, field) )
+            continue;
+
+        report << "    " << std::left << std::setw(4) << std::setfill(' ') << FIELD_NAMES[field] << std::right
+               << ": 0x" << std::setfill('0') << std::setw(2 * FIELD_SIZES[field]) << getField(actual, field)
+               << ", recorded 0x" << std::setw(2 * FIELD_SIZES[field]) << getField(expected, field) << std::endl;
+        registers = true;
+    }
+
+    if( !registers )
+        report << "    registers and timers match, the memory differs" << std::endl;
+
+    d->diverged = true;
+    d->divergence = report.str();
+
+    return false;
+}
+
+// Return the description of the first frame diverging from the recording
+const std::string& Movie::getDivergence() const
+{
+    return data_->divergence;
+}
+
+/* Write the movie to disk
+ * Args:
+ *      filename: the path of the movie
+ * Raises:
+ *      MovieError in case of issues
+ */
+void Movie::save(const std::string &filename) const
+{
+    const OpaqueData *d = data_.get();
+    std::vector<byte_t> buffer(MovieFile::HEADER_SIZE, 0x00);
+
+    // a trace is only kept if every frame has its state
+    bool trace = d->trace && (d->states.size() == d->frames);
+
+    byte_t *header = buffer.data();
+    ::memcpy(&header[0], MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+    putW(&header[4], MovieFile::VERSION);
+    putW(&header[6], trace ? MovieFile::FLAG_TRACE : 0);
+    putL(&header[8], d->romHash);
+    putL(&header[12], d->seed);
+    putL(&header[16], d->frames);
+    putW(&header[20], d->cycles);
+    putL(&header[24], d->events.size());
+
+    uint32_t frame {0};
+    for(const auto &event : d->events)
+    {
+        putVarint(buffer, ((event.frame - frame) << 2) | event.type);
+        frame = event.frame;
+
+        byte_t value[4];
+        putL(value, event.value);
+        buffer.insert(buffer.end(), value, value + ((event.type == EVENT_RESET) ? 4 : 2));
+    }
+
+    // per-frame states, as changes from the previous frame
+    FrameTrace previous;
+    for(size_t i = 0; trace && i < d->states.size(); i++)
+    {
+        const FrameTrace &state = d->states[i];
+
+        uint32_t mask {0};
+        for(int field = 0; field < TRACE_FIELDS; field++) {
+            if( getField(state, field) != getField(previous, field) )
+                mask |= 1 << field;
+        }
+        putVarint(buffer, mask);
+
+        byte_t value[4];
+        for(int field = 0; field < TRACE_FIELDS; field++) {
+            if( (mask & (1 << field)) == 0 )
+                continue;
+            putL(value, getField(state, field));
+            buffer.insert(buffer.end(), value, value + FIELD_SIZES[field]);
+        }
+
+        putL(value, state.hash);
+        buffer.insert(buffer.end(), value, value + 4);
+
+        previous = state;
+    }
+
+    std::ofstream fh(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if( !fh.is_open() )
+        throw MovieError("Unable to create the movie file.");
+
+    fh.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    fh.close();
+
+    if( fh.fail() )
+        throw MovieError("Unable to write the movie file.");
+}
+
+/* Read a movie from disk
+ * Args:
+ *      filename: the path of the movie
+ * Raises:
+ *      MovieError in case of issues
+ */
+void Movie::load(const std::string &filename)
+{
+    std::ifstream fh(filename, std::ios::in | std::ios::binary);
+    if( !fh.is_open() )
+        throw MovieError("Unable to open the movie file.");
+
+    std::vector<byte_t> buffer((std::istreambuf_iterator<char>(fh)), std::istreambuf_iterator<char>());
+
+    // check the header
+    const byte_t *header = buffer.data();
+    if( buffer.size() < MovieFile::HEADER_SIZE || ::memcmp(header, MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) != 0 )
+        throw MovieError("Invalid movie file.");
+
+    if( getW(&header[4]) != MovieFile::VERSION )
+        throw MovieError("Unsupported movie version.");
+
+    OpaqueData *d = data_.get();
+    d->romHash = getL(&header[8]);
+    d->seed = getL(&header[12]);
+    d->frames = getL(&header[16]);
+    d->cycles = getW(&header[20]);
+    d->events.clear();
+    d->trace = (getW(&header[6]) & MovieFile::FLAG_TRACE) != 0;
+    d->states.clear();
+
+    // events
+    uint32_t count = getL(&header[24]);
+    const byte_t *data = header + MovieFile::HEADER_SIZE;
+    const byte_t *end = header + buffer.size();
+
+    uint32_t frame {0};
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t code;
+        if( !getVarint(data, end, code) )
+            throw MovieError("Truncated movie file.");
+
+        Event event;
+        event.frame = frame + (code >> 2);
+        event.type = code & 0x03;
+        if( event.type > EVENT_RESET || event.frame < frame || event.frame > d->frames )
+            throw MovieError("Invalid movie event.");
+
+        size_t size = (event.type == EVENT_RESET) ? 4 : 2;
+        if( static_cast<size_t>(end - data) < size )
+            throw MovieError("Truncated movie file.");
+
+        event.value = (size == 4) ? getL(data) : getW(data);
+        data += size;
+
+        d->events.push_back(event);
+        frame = event.frame;
+    }
+
+    // per-frame states
+    FrameTrace state;
+    for(uint32_t i = 0; d->trace && i < d->frames; i++)
+    {
+        uint32_t mask;
+        if( !getVarint(data, end, mask) || mask >= (1u << TRACE_FIELDS) )
+            throw MovieError("Invalid movie trace.");
+
+        for(int field = 0; field < TRACE_FIELDS; field++)
+        {
+            if( (mask & (1 << field)) == 0 )
+                continue;
+
+            if( end - data < FIELD_SIZES[field] )
+                throw MovieError("Truncated movie file.");
+
+            switch(FIELD_SIZES[field]) {
+                case 1: setField(state, field, data[0]); break;
+                case 2: setField(state, field, getW(data)); break;
+                default: setField(state, field, getL(data)); break;
+            }
+            data += FIELD_SIZES[field];
+        }
+
+        if( end - data < 4 )
+            throw MovieError("Truncated movie file.");
+        state.hash = getL(data);
+        data += 4;
+
+        d->states.push_back(state);
+    }
+}
+
+// Return the number of frames of the movie
+uint32_t Movie::frames() const
+{
+    return data_->frames;
+}
+
+// Return True if the movie holds the state reached by each frame
+bool Movie::hasTrace() const
+{
+    return data_->trace;
+}
+
+// Return the number of frames played since startPlayback()
+uint32_t Movie::position() const
+{
+    return data_->frame;
+}
@@ -0,0 +1,234 @@
+/*
+ * object.cpp
+ * Relocatable objects produced by the assembler and read by the linker
+ */
+
+// includes
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <thread>       // std::this_thread
+#include <unistd.h>     // ::getpid
+
+#include "object.h"
+#include "hashing.h"
+
+namespace fs = std::filesystem;
+
+// first line of an object
+const std::string OBJECT_HEADER = "# c8obj " + std::to_string(ObjectFormat::VERSION);
+
+/* Hash the content of a file
+ * Args:
+ *      filename: the file
+ * Returns:
+ *      the hash of its content, 0 if it cannot be read
+ */
+uint64_t hashSource(const std::string &filename)
+{
+    std::ifstream fh(filename, std::ios::in | std::ios::binary);
+    if( !fh.is_open() )
+        return 0;
+
+    std::string content((std::istreambuf_iterator<char>(fh)), std::istreambuf_iterator<char>());
+    return hashContent(content.data(), content.size());
+}
+
+/* Read an object
+ * Args:
+ *      filename: the object file
+ * Returns:
+ *      False if the file cannot be read or is not a valid object
+ */
+bool ObjectFile::load(const std::string &filename)
+{
+    std::ifstream fh(filename, std::ios::in);
+    if( !fh.is_open() )
+        return false;
+
+    std::string line;
+    if( !std::getline(fh, line) || (line != OBJECT_HEADER) )
+        return false;
+
+    ObjectFile object;
+    while( std::getline(fh, line) )
+    {
+        if( line.empty() || (line[0] == '#') )
+            continue;
+
+        std::istringstream fields(line);
+        std::string record;
+        fields >> record;
+
+        if( record == "source" ) {
+            Source source;
+            fields >> std::hex >> source.hash;
+            if( !fields || (fields.get() != ' ') || !std::getline(fields, source.path) )
+                return false;
+            object.sources.push_back(source);
+        }
+        else if( record == "code" ) {
+            std::string bytes;
+            fields >> bytes;
+            if( bytes.size() % 2 != 0 )
+                return false;
+            for(size_t i = 0; i < bytes.size(); i += 2) {
+                uint8_t byte {0};
+                const char *first = bytes.data() + i;
+                if( std::from_chars(first, first + 2, byte, 16).ptr != first + 2 )
+                    return false;
+                object.code.push_back(byte);
+            }
+        }
+        else if( record == "symbol" ) {
+            Symbol symbol;
+            fields >> std::hex >> symbol.offset >> symbol.name;
+            if( !fields )
+                return false;
+            object.symbols.push_back(symbol);
+        }
+        else if( record == "fixup" ) {
+            Fixup fixup;
+            fields >> std::hex >> fixup.offset >> std::dec >> fixup.line >> fixup.name;
+            if( !fields || (fields.get() != ' ') || !std::getline(fields, fixup.file) )
+                return false;
+            object.fixups.push_back(fixup);
+        }
+        else {
+            return false;
+        }
+    }
+
+    // every offset must be in the code
+    if( object.sources.empty() )
+        return false;
+    for(const auto &symbol : object.symbols) {
+        if( symbol.offset > object.code.size() )
+            return false;
+    }
+    for(const auto &fixup : object.fixups) {
+        if( fixup.offset + 2u > object.code.size() )
+            return false;
+    }
+
+    *this = std::move(object);
+    return true;
+}
+
+/* Write an object
+ * Args:
+ *      filename: the object file
+ * Returns:
+ *      False if the file cannot be written
+ */
+bool ObjectFile::save(const std::string &filename) const
+{
+    std::ofstream fh(filename, std::ios::out | std::ios::trunc);
+    if( !fh.is_open() )
+        return false;
+
+    fh << OBJECT_HEADER << "\n" << std::hex << std::setfill('0');
+    for(const auto &source : sources) {
+        fh << "source " << std::setw(16) << source.hash << " " << source.path << "\n";
+    }
+
+    fh << "code ";
+    for(uint8_t byte : code) {
+        fh << std::setw(2) << static_cast<int>(byte);
+    }
+    fh << "\n";
+
+    for(const auto &symbol : symbols) {
+        fh << "symbol " << std::setw(4) << symbol.offset << " " << symbol.name << "\n";
+    }
+    for(const auto &fixup : fixups) {
+        fh << "fixup " << std::setw(4) << fixup.offset << " " << std::dec << fixup.line << std::hex
+           << " " << fixup.name << " " << fixup.file << "\n";
+    }
+    fh.close();
+
+    return !fh.fail();
+}
+
+
+// constructor
+ObjectCache::ObjectCache(std::string directory) :
+    directory_(std::move(directory))
+{
+}
+
+// destructor
+ObjectCache::~ObjectCache()
+{
+}
+
+// the cache entry of a source, named after its path and content
+std::string ObjectCache::path(const std::string &source) const
+{
+    uint64_t key = hashMix(hashContent(source.data(), source.size()) ^ hashSource(source));
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ObjectFormat::EXTENSION;
+    return (fs::path(directory_) / name.str()).string();
+}
+
+/* Look for the object of a source
+ * Args:
+ *      source: the path of the source
+ *      object: receives the object
+ * Returns:
+ *      True if the source and every file it includes are unchanged
+ */
+bool ObjectCache::fetch(const std::string &source, ObjectFile &object) const
+{
+    ObjectFile cached;
+    if( !cached.load(path(source)) )
+        return false;
+
+    if( cached.sources.front().path != source )
+        return false;
+
+    for(const auto &file : cached.sources) {
+        if( hashSource(file.path) != file.hash )
+            return false;
+    }
+
+    object = std::move(cached);
+    return true;
+}
+
+/* Keep the object of a source
+ * Args:
+ *      source: the path of the source
+ *      object: its object
+ * Returns:
+ *      False if the object cannot be written in the cache
+ */
+bool ObjectCache::store(const std::string &source, const ObjectFile &object) const
+{
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if( error )
+        return false;
+
+    // written aside under a name of its own then renamed, concurrent builds
+    // neither share the temporary file nor read a partial object
+    std::string filename = path(source);
+    std::string temporary = filename + ".tmp." + std::to_string(::getpid()) + "." +
+                            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    if( !object.save(temporary) ) {
+        fs::remove(temporary, error);
+        return false;
+    }
+
+    fs::rename(temporary, filename, error);
+    if( error ) {
+        std::error_code ignored;
+        fs::remove(temporary, ignored);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,193 @@
+/*
+ * perf.cpp
+ * Hardware performance counters implementation
+ */
+
+// includes
+#include <cerrno>
+#include <cstring>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf.h"
+#include "except.h"
+
+/* <linux/perf_event.h> cannot be included: the assembler's includes/asm/types.h
+ * shadows <asm/types.h>. The first version of the attribute structure, which
+ * every kernel accepts, and the few constants used are declared here.
+ */
+struct PerfEventAttr
+{
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t samplePeriod;
+    uint64_t sampleType;
+    uint64_t readFormat;
+    uint64_t flags;
+    uint32_t wakeupEvents;
+    uint32_t bpType;
+    uint64_t config1;
+};
+
+constexpr uint32_t PERF_TYPE_HARDWARE_ = 0;
+constexpr uint32_t PERF_TYPE_HW_CACHE_ = 3;
+
+constexpr uint64_t COUNT_HW_CPU_CYCLES = 0;
+constexpr uint64_t COUNT_HW_INSTRUCTIONS = 1;
+constexpr uint64_t COUNT_HW_BRANCH_MISSES = 5;
+
+// L1D cache, read accesses, misses
+constexpr uint64_t COUNT_HW_CACHE_L1D_READ_MISS = 0 | (0 << 8) | (1 << 16);
+
+// attribute flags: disabled, exclude_kernel, exclude_hv
+constexpr uint64_t FLAG_DISABLED = 1ull << 0;
+constexpr uint64_t FLAG_EXCLUDE_KERNEL = 1ull << 5;
+constexpr uint64_t FLAG_EXCLUDE_HV = 1ull << 6;
+
+// read format: time enabled & running, to scale multiplexed counters
+constexpr uint64_t FORMAT_TOTAL_TIME_ENABLED = 1 << 0;
+constexpr uint64_t FORMAT_TOTAL_TIME_RUNNING = 1 << 1;
+
+// ioctl requests, _IO('$', n)
+constexpr unsigned long IOC_ENABLE = _IO('$', 0);
+constexpr unsigned long IOC_DISABLE = _IO('$', 1);
+constexpr unsigned long IOC_RESET = _IO('$', 3);
+
+// PerfCounters structure
+struct PerfCounters::OpaqueData
+{
+    int fd[COUNT] {-1, -1, -1, -1};
+    uint64_t values[COUNT] {0, 0, 0, 0};
+    std::string error;
+
+    void open(Counter counter, uint32_t type, uint64_t config);
+};
+
+/* Open one counter for the calling thread on any CPU
+ * Args:
+ *      counter: the slot of the counter
+ *      type, config: the event to count
+ */
+void PerfCounters::OpaqueData::open(Counter counter, uint32_t type, uint64_t config)
+{
+    PerfEventAttr attr;
+    ::memset(&attr, 0, sizeof(attr));
+
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.readFormat = FORMAT_TOTAL_TIME_ENABLED | FORMAT_TOTAL_TIME_RUNNING;
+    attr.flags = FLAG_DISABLED | FLAG_EXCLUDE_KERNEL | FLAG_EXCLUDE_HV;
+
+    long result = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if( result < 0 ) {
+        if( error.empty() )
+            error = std::string(name(counter)) + ": " + ::strerror(errno);
+        return;
+    }
+
+    fd[counter] = static_cast<int>(result);
+}
+
+// Constructor, opens the counters the host provides
+PerfCounters::PerfCounters() :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for PerfCounters structure.");
+    }
+
+    data_->open(CYCLES, PERF_TYPE_HARDWARE_, COUNT_HW_CPU_CYCLES);
+    data_->open(INSTRUCTIONS, PERF_TYPE_HARDWARE_, COUNT_HW_INSTRUCTIONS);
+    data_->open(BRANCH_MISSES, PERF_TYPE_HARDWARE_, COUNT_HW_BRANCH_MISSES);
+    data_->open(L1D_MISSES, PERF_TYPE_HW_CACHE_, COUNT_HW_CACHE_L1D_READ_MISS);
+}
+
+// Destructor
+PerfCounters::~PerfCounters()
+{
+    for(int fd : data_->fd) {
+        if( fd >= 0 )
+            ::close(fd);
+    }
+}
+
+// Reset and start the counters
+void PerfCounters::start()
+{
+    for(int fd : data_->fd) {
+        if( fd >= 0 ) {
+            ::ioctl(fd, IOC_RESET, 0);
+            ::ioctl(fd, IOC_ENABLE, 0);
+        }
+    }
+}
+
+// Stop the counters and read their values
+void PerfCounters::stop()
+{
+    for(int fd : data_->fd) {
+        if( fd >= 0 )
+            ::ioctl(fd, IOC_DISABLE, 0);
+    }
+
+    for(int i = 0; i < COUNT; i++)
+    {
+        data_->values[i] = 0;
+        if( data_->fd[i] < 0 )
+            continue;
+
+        // value, time enabled, time running
+        uint64_t buffer[3];
+        if( ::read(data_->fd[i], buffer, sizeof(buffer)) != sizeof(buffer) )
+            continue;
+
+        // the counter shared the hardware with others part of the time
+        if( buffer[2] > 0 && buffer[2] < buffer[1] )
+            data_->values[i] = static_cast<uint64_t>(static_cast<double>(buffer[0]) * buffer[1] / buffer[2]);
+        else
+            data_->values[i] = buffer[0];
+    }
+}
+
+// Return True if at least one counter could be opened
+bool PerfCounters::available() const
+{
+    for(int fd : data_->fd) {
+        if( fd >= 0 )
+            return true;
+    }
+    return false;
+}
+
+// Return True if the counter could be opened
+bool PerfCounters::available(Counter counter) const
+{
+    return data_->fd[counter] >= 0;
+}
+
+// Return the number of events counted between the last start() and stop()
+uint64_t PerfCounters::value(Counter counter) const
+{
+    return data_->values[counter];
+}
+
+// Return the reason of the first counter that could not be opened
+const std::string& PerfCounters::error() const
+{
+    return data_->error;
+}
+
+// Return the name of a counter
+const char* PerfCounters::name(Counter counter)
+{
+    switch(counter) {
+        case CYCLES:        return "cycles";
+        case INSTRUCTIONS:  return "instructions";
+        case BRANCH_MISSES: return "branch_misses";
+        case L1D_MISSES:    return "l1d_misses";
+        default:            return "unknown";
+    }
+}
@@ -0,0 +1,144 @@
+/*
+ * pool.cpp
+ * Pool of machines implementation
+ */
+
+// includes
+#include <new>
+#include <vector>
+
+#include "pool.h"
+#include "except.h"
+
+// slots are aligned on cache lines
+constexpr size_t CACHE_LINE = 64;
+
+// Pool structure
+struct MachinePool::OpaqueData
+{
+    // one slot per machine: the Machine object then its storage
+    byte_t *arena {nullptr};
+    size_t header {0};
+    size_t slot {0};
+    int capacity {0};
+
+    // indexes of the free slots, and of the slots in use
+    std::vector<int> free;
+    std::vector<bool> used;
+
+    void create();
+    void destroy();
+
+    byte_t* slotAt(int index) const { return arena + index * slot; }
+};
+
+// initialize structure
+void MachinePool::OpaqueData::create()
+{
+    header = (sizeof(Machine) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+    slot = header + Machine::storageSize();
+
+    // the pages are only backed by memory once a machine touches them
+    arena = static_cast<byte_t*>(::operator new(slot * capacity, std::align_val_t(CACHE_LINE), std::nothrow));
+    if( arena == nullptr )
+        throw VMError("Unable to allocate memory for the Machine pool.");
+
+    free.reserve(capacity);
+    for(int i = capacity - 1; i >= 0; i--) {
+        free.push_back(i);
+    }
+    used.assign(capacity, false);
+}
+
+// de-initialize structure
+void MachinePool::OpaqueData::destroy()
+{
+    if( arena == nullptr )
+        return;
+
+    for(int i = 0; i < capacity; i++) {
+        if( used[i] )
+            reinterpret_cast<Machine*>(slotAt(i))->~Machine();
+    }
+
+    ::operator delete(arena, std::align_val_t(CACHE_LINE));
+}
+
+/* Constructor
+ * Args:
+ *      capacity: the maximum number of machines
+ * Raises:
+ *      VMError in case of issues
+ */
+MachinePool::MachinePool(int capacity) :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for MachinePool structure.");
+    }
+
+    data_->capacity = capacity;
+    data_->create();
+}
+
+// Destructor, the machines still in use are destroyed
+MachinePool::~MachinePool()
+{
+    data_->destroy();
+}
+
+/* Build a machine in a free slot, nothing is allocated
+ * Returns:
+ *      the machine in its power-on state, nullptr if the pool is exhausted
+ */
+Machine* MachinePool::acquire()
+{
+    if( data_->free.empty() )
+        return nullptr;
+
+    int index = data_->free.back();
+    data_->free.pop_back();
+    data_->used[index] = true;
+
+    byte_t *slot = data_->slotAt(index);
+    return new (slot) Machine(slot + data_->header);
+}
+
+/* Destroy a machine and give its slot back to the pool
+ * Args:
+ *      machine: a machine acquired from this pool
+ */
+void MachinePool::release(Machine *machine)
+{
+    byte_t *slot = reinterpret_cast<byte_t*>(machine);
+    size_t offset = slot - data_->arena;
+
+    if( slot < data_->arena || offset % data_->slot != 0 )
+        throw VMError("Machine released to the wrong pool.");
+
+    int index = offset / data_->slot;
+    if( index >= data_->capacity || !data_->used[index] )
+        throw VMError("Machine released to the wrong pool.");
+
+    machine->~Machine();
+    data_->used[index] = false;
+    data_->free.push_back(index);
+}
+
+// Return the maximum number of machines
+int MachinePool::capacity() const
+{
+    return data_->capacity;
+}
+
+// Return the number of free slots
+int MachinePool::available() const
+{
+    return data_->free.size();
+}
+
+// Return the memory used by each machine
+size_t MachinePool::slotSize() const
+{
+    return data_->slot;
+}
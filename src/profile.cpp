@@ -0,0 +1,132 @@
+/*
+ * profile.cpp
+ * Memory access profile implementation
+ */
+
+// includes
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "profile.h"
+#include "except.h"
+
+// name of the zone holding an address
+static const char* zoneName(int address)
+{
+    if( address <= MemoryZone::ROM_END )
+        return "rom";
+    if( address <= MemoryZone::CODE_END )
+        return "code";
+    if( address <= MemoryZone::STACK_END )
+        return "stack";
+    if( address <= MemoryZone::PERIPH_END )
+        return "periph";
+    return "screen";
+}
+
+// Constructor
+MemoryProfile::MemoryProfile() :
+    reads_(MemoryZone::TOTAL_MEMORY_SIZE, 0),
+    writes_(MemoryZone::TOTAL_MEMORY_SIZE, 0),
+    executes_(MemoryZone::TOTAL_MEMORY_SIZE, 0)
+{ }
+
+// Destructor
+MemoryProfile::~MemoryProfile()
+{ }
+
+// Reset every counter
+void MemoryProfile::clear()
+{
+    std::fill(reads_.begin(), reads_.end(), 0);
+    std::fill(writes_.begin(), writes_.end(), 0);
+    std::fill(executes_.begin(), executes_.end(), 0);
+    instructions_ = 0;
+    lowest_ = MemoryZone::STACK_END;
+}
+
+// Return the addresses both written and executed
+std::vector<word_t> MemoryProfile::selfModifying() const
+{
+    std::vector<word_t> addresses;
+    for(int i = 0; i < MemoryZone::TOTAL_MEMORY_SIZE; i++) {
+        if( writes_[i] > 0 && executes_[i] > 0 )
+            addresses.push_back(i);
+    }
+    return addresses;
+}
+
+// Return the lowest value of the stack pointer, below STACK_BEGIN on overflow
+word_t MemoryProfile::lowestStack() const
+{
+    return lowest_;
+}
+
+// Return the largest number of return addresses stacked at once
+int MemoryProfile::peakDepth() const
+{
+    return (MemoryZone::STACK_END - lowest_) / 2;
+}
+
+/* Write a summary of the profile
+ * Args:
+ *      out: the destination stream
+ */
+void MemoryProfile::report(std::ostream &out) const
+{
+    int executed {0};
+    int written {0};
+    for(int i = MemoryZone::CODE_BEGIN; i <= MemoryZone::CODE_END; i++) {
+        executed += (executes_[i] > 0) ? 1 : 0;
+        written += (writes_[i] > 0) ? 1 : 0;
+    }
+
+    std::vector<word_t> smc = selfModifying();
+
+    out << "Memory profile: " << instructions_ << " instructions" << std::endl;
+    out << "    code bytes executed : " << executed << std::endl;
+    out << "    code bytes written  : " << written << std::endl;
+    out << "    peak stack depth    : " << peakDepth() << " calls, lowest SP 0x"
+        << std::hex << std::setw(4) << std::setfill('0') << lowest_ << std::dec << std::setfill(' ');
+    if( lowest_ < MemoryZone::STACK_BEGIN )
+        out << ", overflows the stack zone" << std::endl;
+    else
+        out << ", " << (lowest_ - MemoryZone::STACK_BEGIN) << " bytes left" << std::endl;
+
+    out << "    self-modifying code : " << smc.size() << " addresses";
+    for(size_t i = 0; i < smc.size() && i < 8; i++) {
+        out << (i == 0 ? " (0x" : ", 0x") << std::hex << std::setw(3) << std::setfill('0') << smc[i] << std::dec;
+    }
+    out << std::setfill(' ') << ((smc.size() > 8) ? ", ...)" : (smc.empty() ? "" : ")")) << std::endl;
+
+    out << "    cached execution    : " << (smc.empty() ? "safe" : "unsafe") << std::endl;
+}
+
+/* Write the heatmap of the program space (ROM & code zones) and of the stack
+ * One CSV line per address: address, zone, reads, writes, executions and 1
+ * for self-modifying code.
+ * Args:
+ *      filename: the path of the heatmap
+ * Raises:
+ *      VMError in case of issues
+ */
+void MemoryProfile::save(const std::string &filename) const
+{
+    std::ofstream fh(filename, std::ios::out | std::ios::trunc);
+    if( !fh.is_open() )
+        throw VMError("Unable to create the profile file.");
+
+    fh << "address,zone,reads,writes,executes,smc" << std::endl;
+    for(int i = 0; i <= MemoryZone::STACK_END; i++)
+    {
+        fh << "0x" << std::hex << std::setw(3) << std::setfill('0') << i << std::dec << ","
+           << zoneName(i) << ","
+           << reads_[i] << "," << writes_[i] << "," << executes_[i] << ","
+           << ((writes_[i] > 0 && executes_[i] > 0) ? 1 : 0) << "\n";
+    }
+    fh.close();
+
+    if( fh.fail() )
+        throw VMError("Unable to write the profile file.");
+}
@@ -0,0 +1,123 @@
+/*
+ * rewind.cpp
+ * Rewind buffer implementation
+ */
+
+// includes
+#include <utility>
+#include "rewind.h"
+#include "delta.h"
+#include "except.h"
+
+/* Constructor
+ * Args:
+ *      capacity: the number of snapshots to keep
+ *      interval: the number of frames between two snapshots
+ */
+RewindBuffer::RewindBuffer(int capacity, int interval) :
+    capacity_(capacity),
+    interval_(interval > 0 ? interval : 1),
+    head_(new (std::nothrow) Snapshot()),
+    next_(new (std::nothrow) Snapshot())
+{
+    if( (head_ == nullptr) || (next_ == nullptr) ) {
+        throw VMError("Unable to allocate memory for the rewind buffer.");
+    }
+}
+
+// Destructor
+RewindBuffer::~RewindBuffer()
+{ }
+
+/* Record the machine state every interval frames
+ * Args:
+ *      machine: the machine to record
+ */
+void RewindBuffer::record(const Machine &machine)
+{
+    atHead_ = false;
+
+    if( hasHead_ && (++frames_ < interval_) )
+        return;
+    frames_ = 0;
+
+    // first snapshot, nothing to compare with
+    if( !hasHead_ ) {
+        machine.snapshot(*head_);
+        hasHead_ = true;
+        return;
+    }
+
+    machine.snapshot(*next_);
+
+    // reuse the storage of the oldest delta once the ring is full
+    std::vector<byte_t> delta;
+    if( static_cast<int>(deltas_.size()) >= capacity_ ) {
+        delta = std::move(deltas_.front());
+        deltas_.pop_front();
+        delta.clear();
+    }
+
+    deltaEncode(reinterpret_cast<const byte_t*>(next_.get()),
+                reinterpret_cast<const byte_t*>(head_.get()),
+                sizeof(Snapshot), delta);
+    deltas_.push_back(std::move(delta));
+
+    std::swap(head_, next_);
+}
+
+/* Step back in time
+ * The first call returns to the newest snapshot, the following ones walk
+ * back one snapshot each.
+ * Args:
+ *      machine: the machine to restore
+ * Returns:
+ *      false if there is no older snapshot
+ */
+bool RewindBuffer::rewind(Machine &machine)
+{
+    if( !hasHead_ )
+        return false;
+
+    if( atHead_ )
+    {
+        if( deltas_.empty() )
+            return false;
+
+        // the delta turns the head into the snapshot before it
+        const std::vector<byte_t> &delta = deltas_.back();
+        deltaApply(delta.data(), delta.size(), reinterpret_cast<byte_t*>(head_.get()), sizeof(Snapshot));
+        deltas_.pop_back();
+    }
+
+    machine.restore(*head_);
+    atHead_ = true;
+    frames_ = 0;
+
+    return true;
+}
+
+// Drop all the snapshots
+void RewindBuffer::clear()
+{
+    deltas_.clear();
+    hasHead_ = false;
+    atHead_ = false;
+    frames_ = 0;
+}
+
+// Return the number of snapshots available
+int RewindBuffer::size() const
+{
+    return hasHead_ ? deltas_.size() + 1 : 0;
+}
+
+// Return the memory used by the deltas
+size_t RewindBuffer::memoryUsage() const
+{
+    size_t total {0};
+    for(auto &delta : deltas_) {
+        total += delta.capacity();
+    }
+    return total;
+}
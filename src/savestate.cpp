@@ -0,0 +1,169 @@
+/*
+ * savestate.cpp
+ * On-disk save states implementation
+ */
+
+// includes
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "savestate.h"
+#include "delta.h"
+#include "binary.h"
+#include "hashing.h"
+#include "mapping.h"
+#include "constants.h"
+#include "except.h"
+
+// file signature
+const char MAGIC[4] = { 'C', '8', 'S', 'T' };
+
+/* Serialize the state of a machine in memory, using the file layout
+ * Args:
+ *      machine: the machine to save
+ *      buffer: the destination, replaced by the header and the payload
+ *      compress: store the memory as a delta against the boot image
+ */
+void saveState(const Machine &machine, std::vector<byte_t> &buffer, bool compress)
+{
+    Snapshot state;
+    machine.snapshot(state);
+
+    buffer.assign(SaveState::HEADER_SIZE, 0x00);
+
+    // memory payload, appended after the header
+    if( compress ) {
+        std::vector<byte_t> boot(MemoryZone::TOTAL_MEMORY_SIZE);
+        std::vector<byte_t> payload;
+        machine.bootImage(boot.data());
+        deltaEncode(boot.data(), &state.memory[0], MemoryZone::TOTAL_MEMORY_SIZE, payload);
+        buffer.insert(buffer.end(), payload.begin(), payload.end());
+    } else {
+        buffer.insert(buffer.end(), &state.memory[0], &state.memory[0] + MemoryZone::TOTAL_MEMORY_SIZE);
+    }
+
+    // header
+    byte_t *header = buffer.data();
+    ::memcpy(&header[0], MAGIC, sizeof(MAGIC));
+    putW(&header[4], SaveState::VERSION);
+    putW(&header[6], compress ? SaveState::FLAG_DELTA : 0);
+    putL(&header[8], MemoryZone::TOTAL_MEMORY_SIZE);
+    putL(&header[12], buffer.size() - SaveState::HEADER_SIZE);
+    putL(&header[16], hashRom(machine.getRom()));
+    ::memcpy(&header[20], &state.cpu.V[0], sizeof(state.cpu.V));
+    putW(&header[36], state.cpu.I);
+    putW(&header[38], state.cpu.PC);
+    putW(&header[40], state.cpu.SP);
+    putL(&header[44], state.cpu.seed);
+}
+
+/* Write the state of a machine to disk
+ * Args:
+ *      machine: the machine to save
+ *      filename: the path of the save state
+ *      compress: store the memory as a delta against the boot image
+ * Raises:
+ *      StateError in case of issues
+ */
+void saveState(const Machine &machine, const std::string &filename, bool compress)
+{
+    std::vector<byte_t> buffer;
+    saveState(machine, buffer, compress);
+
+    std::ofstream fh(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if( !fh.is_open() )
+        throw StateError("Unable to create the save state file.");
+
+    fh.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    fh.close();
+
+    if( fh.fail() )
+        throw StateError("Unable to write the save state file.");
+}
+
+/* Restore the state of a machine from a serialized state
+ * Args:
+ *      machine: the machine to restore
+ *      buffer: the serialized state, in the file layout
+ *      size: the size of the buffer
+ * Raises:
+ *      StateError in case of issues
+ */
+void loadState(Machine &machine, const byte_t *buffer, size_t size)
+{
+    // check the header
+    const byte_t *header = buffer;
+    if( size < SaveState::HEADER_SIZE )
+        throw StateError("Invalid save state file.");
+
+    if( ::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 )
+        throw StateError("Invalid save state file.");
+
+    if( getW(&header[4]) != SaveState::VERSION )
+        throw StateError("Unsupported save state version.");
+
+    if( getL(&header[8]) != MemoryZone::TOTAL_MEMORY_SIZE )
+        throw StateError("Save state memory size mismatch.");
+
+    word_t flags = getW(&header[6]);
+    uint32_t length = getL(&header[12]);
+    if( length > size - SaveState::HEADER_SIZE )
+        throw StateError("Truncated save state file.");
+
+    // registers
+    CPUState state;
+    ::memcpy(&state.V[0], &header[20], sizeof(state.V));
+    state.I = getW(&header[36]);
+    state.PC = getW(&header[38]);
+    state.SP = getW(&header[40]);
+    state.seed = getL(&header[44]);
+
+    const byte_t *payload = buffer + SaveState::HEADER_SIZE;
+
+    // raw image, restored straight from the buffer
+    if( (flags & SaveState::FLAG_DELTA) == 0 )
+    {
+        if( length != MemoryZone::TOTAL_MEMORY_SIZE )
+            throw StateError("Invalid save state memory image.");
+
+        machine.restore(state, payload);
+        return;
+    }
+
+    // delta against the boot image of the same ROM
+    if( getL(&header[16]) != hashRom(machine.getRom()) )
+        throw StateError("Save state was taken with a different ROM.");
+
+    std::vector<byte_t> memory(MemoryZone::TOTAL_MEMORY_SIZE);
+    machine.bootImage(memory.data());
+    if( !deltaApply(payload, length, memory.data(), MemoryZone::TOTAL_MEMORY_SIZE) )
+        throw StateError("Invalid save state memory delta.");
+
+    machine.restore(state, memory.data());
+}
+
+/* Restore the state of a machine from disk
+ * The file is mapped in memory and a raw memory image is restored straight
+ * from the mapping.
+ * Args:
+ *      machine: the machine to restore
+ *      filename: the path of the save state
+ * Raises:
+ *      StateError in case of issues
+ */
+void loadState(Machine &machine, const std::string &filename)
+{
+    Mapping file;
+
+    if( !file.map(filename) ) {
+        if( file.fd < 0 )
+            throw StateError("Unable to open the save state file.");
+        throw StateError("Unable to map the save state file.");
+    }
+
+    if( file.size < SaveState::HEADER_SIZE )
+        throw StateError("Invalid save state file.");
+
+    loadState(machine, file.data, file.size);
+}
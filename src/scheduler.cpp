@@ -0,0 +1,308 @@
+/*
+ * scheduler.cpp
+ * Cooperative scheduler implementation
+ */
+
+// includes
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "scheduler.h"
+#include "constants.h"
+#include "except.h"
+
+// what a machine is waiting for
+enum WaitState {
+    RUNNABLE = 0,
+    WAIT_KEY,
+    WAIT_TIMER,
+    HALTED
+};
+
+// a scheduled machine
+struct Task
+{
+    std::unique_ptr<Machine> machine;
+    WaitState state {RUNNABLE};
+
+    // number of frames the machine has been brought to
+    uint64_t synced {0};
+
+    // delay timer loop: frame to wake up at, address of the loop and register
+    uint64_t wake {0};
+    word_t loop {0};
+    int x {0};
+};
+
+// Scheduler structure
+struct Scheduler::OpaqueData
+{
+    int cycles {Constants::CYCLES_PER_FRAME};
+    uint64_t frame {0};
+
+    std::vector<Task> tasks;
+    std::vector<int> running;
+
+    // machines waiting for their delay timer, soonest first
+    using Alarm = std::pair<uint64_t, int>;
+    std::priority_queue<Alarm, std::vector<Alarm>, std::greater<Alarm>> alarms;
+
+    bool waitsForKey(Task &task, const CPUState &state);
+    bool waitsForTimer(Task &task, const CPUState &state);
+    void wake(int id);
+    void sync(Task &task);
+};
+
+/* Check if a machine is spinning on LD Vx, K with no key pressed
+ * Args:
+ *      task: the task of the machine
+ *      state: its registers
+ */
+bool Scheduler::OpaqueData::waitsForKey(Task &task, const CPUState &state)
+{
+    MMU *memory = task.machine->getMMU();
+
+    if( state.PC < MemoryZone::CODE_BEGIN || state.PC >= MemoryZone::CODE_END )
+        return false;
+
+    return ((memory->readW(state.PC) & 0xF0FF) == 0xF00A) && (task.machine->getKeys() == 0);
+}
+
+/* Check if a machine is spinning until its delay timer expires, in a loop of
+ * the form  A: LD Vx, DT / SE Vx, #00 / JP A
+ * Args:
+ *      task: the task of the machine, receives the loop address & register
+ *      state: its registers
+ */
+bool Scheduler::OpaqueData::waitsForTimer(Task &task, const CPUState &state)
+{
+    MMU *memory = task.machine->getMMU();
+
+    if( memory->readB(MemoryRegister::DELAY_TIMER) == 0 )
+        return false;
+
+    // the PC may be on any of the three instructions
+    for(int phase = 0; phase < 3; phase++)
+    {
+        int loop = state.PC - 2 * phase;
+        if( loop < MemoryZone::CODE_BEGIN || loop + 5 > MemoryZone::CODE_END )
+            continue;
+
+        word_t load = memory->readW(loop);
+        if( (load & 0xF0FF) != 0xF007 )
+            continue;
+
+        int x = (load & 0x0F00) >> 8;
+        if( memory->readW(loop + 2) != (0x3000 | (x << 8)) )
+            continue;
+        if( memory->readW(loop + 4) != (0x1000 | loop) )
+            continue;
+
+        // about to test a register already cleared, the loop exits
+        if( phase == 1 && state.V[x] == 0 )
+            return false;
+
+        task.loop = loop;
+        task.x = x;
+        return true;
+    }
+
+    return false;
+}
+
+/* Bring a parked machine to the current frame and make it runnable
+ * Args:
+ *      id: the machine to wake up
+ */
+void Scheduler::OpaqueData::wake(int id)
+{
+    Task &task = tasks[id];
+    if( task.state != WAIT_KEY && task.state != WAIT_TIMER )
+        return;
+
+    sync(task);
+    task.state = RUNNABLE;
+    running.push_back(id);
+}
+
+/* Emulate the frames a parked machine skipped, in closed form
+ * Args:
+ *      task: the parked machine
+ */
+void Scheduler::OpaqueData::sync(Task &task)
+{
+    uint64_t frames = frame - task.synced;
+    if( frames == 0 )
+        return;
+
+    MMU *memory = task.machine->getMMU();
+    byte_t delay = memory->readB(MemoryRegister::DELAY_TIMER);
+    byte_t sound = memory->readB(MemoryRegister::SOUND_TIMER);
+
+    // at most the remaining delay for a timer loop, by construction
+    int count = std::min<uint64_t>(frames, 255);
+
+    if( task.state == WAIT_TIMER )
+    {
+        CPUState state;
+        task.machine->getRegisters(state);
+
+        // each frame runs the three instructions loop from where it stopped,
+        // the register gets the timer value whenever LD Vx, DT is executed
+        int phase = (state.PC - task.loop) / 2;
+        for(int i = 0; i < count; i++) {
+            if( (3 - phase) % 3 < cycles )
+                state.V[task.x] = delay - i;
+            phase = (phase + cycles) % 3;
+        }
+
+        state.PC = task.loop + 2 * phase;
+        task.machine->setRegisters(state);
+    }
+
+    // the timers kept running, a key wait leaves everything else untouched
+    memory->writeB(MemoryRegister::DELAY_TIMER, delay - std::min<int>(delay, count));
+    memory->writeB(MemoryRegister::SOUND_TIMER, sound - std::min<int>(sound, count));
+
+    task.synced = frame;
+}
+
+/* Constructor
+ * Args:
+ *      cycles: the number of instructions executed per frame
+ * Raises:
+ *      VMError in case of issues
+ */
+Scheduler::Scheduler(int cycles) :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for Scheduler structure.");
+    }
+
+    data_->cycles = cycles;
+}
+
+// Destructor
+Scheduler::~Scheduler()
+{ }
+
+/* Add a machine, it joins at the current frame
+ * Args:
+ *      machine: the machine to schedule
+ * Returns:
+ *      the id of the machine
+ */
+int Scheduler::add(std::unique_ptr<Machine> machine)
+{
+    Task task;
+    task.machine = std::move(machine);
+    task.synced = data_->frame;
+
+    data_->tasks.push_back(std::move(task));
+    data_->running.push_back(data_->tasks.size() - 1);
+
+    return data_->tasks.size() - 1;
+}
+
+/* Return a machine brought to the current frame
+ * As the caller may change it, a parked machine becomes runnable again.
+ * Args:
+ *      id: the id of the machine
+ */
+Machine& Scheduler::get(int id)
+{
+    data_->wake(id);
+    return *data_->tasks[id].machine;
+}
+
+/* Set the keyboard status of a machine, waking it if it waits for a key
+ * Args:
+ *      id: the id of the machine
+ *      keys: one bit per key, set when the key is pressed
+ */
+void Scheduler::setKeys(int id, word_t keys)
+{
+    Task &task = data_->tasks[id];
+
+    if( task.state == WAIT_KEY && keys != 0 )
+        data_->wake(id);
+
+    task.machine->setKeys(keys);
+}
+
+// Emulate one frame of every runnable machine
+void Scheduler::runFrame()
+{
+    OpaqueData *d = data_.get();
+
+    // delay timers expiring now, stale alarms are dropped
+    while( !d->alarms.empty() && d->alarms.top().first <= d->frame )
+    {
+        int id = d->alarms.top().second;
+        uint64_t wake = d->alarms.top().first;
+        d->alarms.pop();
+
+        if( d->tasks[id].state == WAIT_TIMER && d->tasks[id].wake == wake )
+            d->wake(id);
+    }
+
+    size_t i {0};
+    while( i < d->running.size() )
+    {
+        int id = d->running[i];
+        Task &task = d->tasks[id];
+
+        try {
+            task.machine->runFrame(d->cycles);
+        } catch(const std::exception&) {
+            // a faulty program stops, the others go on
+            task.state = HALTED;
+        }
+        task.synced = d->frame + 1;
+
+        if( task.state == RUNNABLE ) {
+            CPUState state;
+            task.machine->getRegisters(state);
+
+            if( d->waitsForKey(task, state) )
+                task.state = WAIT_KEY;
+            else if( d->waitsForTimer(task, state) )
+                task.state = WAIT_TIMER;
+        }
+
+        if( task.state == RUNNABLE ) {
+            i++;
+        } else {
+            // the last machine of the list takes this place
+            d->running[i] = d->running.back();
+            d->running.pop_back();
+            if( task.state == WAIT_TIMER ) {
+                task.wake = task.synced + task.machine->getMMU()->readB(MemoryRegister::DELAY_TIMER);
+                d->alarms.push(OpaqueData::Alarm(task.wake, id));
+            }
+        }
+    }
+
+    d->frame++;
+}
+
+// Return the number of frames emulated
+uint64_t Scheduler::getFrame() const
+{
+    return data_->frame;
+}
+
+// Return the number of machines scheduled
+int Scheduler::size() const
+{
+    return data_->tasks.size();
+}
+
+// Return the number of machines currently runnable
+int Scheduler::runnable() const
+{
+    return data_->running.size();
+}
@@ -0,0 +1,658 @@
+/*
+ * search.cpp
+ * Parallel state space search implementation
+ */
+
+// includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "search.h"
+#include "pool.h"
+#include "delta.h"
+#include "constants.h"
+#include "except.h"
+
+// a state of the frontier, kept as a delta against the start state
+struct Node
+{
+    std::vector<byte_t> delta;
+    uint64_t memoryHash {0};
+};
+
+// how a node of a depth was reached, kept to rebuild the path
+struct Step
+{
+    int parent;
+    word_t action;
+};
+
+// a state reached while expanding a depth, before the duplicates are removed
+struct Candidate
+{
+    uint64_t hash;
+    int parent;
+    int action;                     // index in the actions
+    int score;
+    bool goal;
+};
+
+// set of state hashes, open addressing with linear probing
+class VisitedSet
+{
+    public:
+        explicit VisitedSet(size_t capacity)
+        {
+            size_t size {1};
+            while( size < capacity + capacity / 2 ) {
+                size <<= 1;
+            }
+
+            slots_ = std::unique_ptr<uint64_t[]>(new (std::nothrow) uint64_t[size]);
+            if( slots_ == nullptr )
+                throw VMError("Unable to allocate memory for the visited states.");
+
+            std::fill(slots_.get(), slots_.get() + size, 0);
+            mask_ = size - 1;
+            limit_ = capacity;
+        }
+
+        /* Add a hash to the set
+         * Returns:
+         *      False if the hash was already there or the set is full
+         */
+        bool insert(uint64_t hash)
+        {
+            size_t index = find(hash);
+            if( slots_[index] != 0 || count_ >= limit_ )
+                return false;
+
+            slots_[index] = key(hash);
+            count_++;
+            return true;
+        }
+
+        // true if the hash is in the set, safe to call from several threads between the inserts
+        bool contains(uint64_t hash) const
+        {
+            return slots_[find(hash)] != 0;
+        }
+
+        uint64_t size() const { return count_; }
+
+    private:
+        // 0 marks the free slots
+        static uint64_t key(uint64_t hash) { return hash ? hash : 1; }
+
+        // the slot of the hash, or the free slot ending its probe sequence
+        size_t find(uint64_t hash) const
+        {
+            hash = key(hash);
+
+            size_t index = hash & mask_;
+            while( slots_[index] != 0 && slots_[index] != hash ) {
+                index = (index + 1) & mask_;
+            }
+            return index;
+        }
+
+    private:
+        std::unique_ptr<uint64_t[]> slots_;
+        size_t mask_ {0};
+        uint64_t limit_ {0};
+        uint64_t count_ {0};
+};
+
+// work shared by the threads during a run
+enum class Phase
+{
+    EXPAND,                         // try every action on the frontier
+    BUILD                           // compute the states kept for the next depth
+};
+
+// Search structure
+struct Search::OpaqueData
+{
+    const Machine *start {nullptr};
+
+    std::vector<word_t> actions;
+    int frames {1};
+    int cycles {Constants::CYCLES_PER_FRAME};
+    int depth {600};
+    int width {0};
+    int threads {1};
+    size_t capacity {1 << 22};
+    size_t memoryLimit {size_t(1) << 30};
+
+    std::vector<word_t> path;
+    uint64_t visited {0};
+
+    // state of the current run
+    const Goal *goal {nullptr};
+    const Score *score {nullptr};
+    VisitedSet *visitedSet {nullptr};
+    std::vector<Machine*> machines;
+    std::unique_ptr<Snapshot[]> states;     // start state, then one scratch state per thread
+
+    // current depth & the next one
+    std::vector<Node> frontier;
+    std::vector<Node> children;
+    std::vector<std::vector<Candidate>> candidates;
+    std::vector<Candidate> kept;
+    std::vector<std::vector<Step>> steps;
+    std::atomic<size_t> next {0};
+    std::atomic<size_t> goalIndex {0};
+    std::atomic<size_t> memory {0};         // bytes used by the frontier, the candidates & the children
+
+    // worker threads, alive during a run, the caller being thread 0
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable finished;
+    uint64_t round {0};
+    int pending {0};
+    bool stopping {false};
+    Phase phase {Phase::EXPAND};
+    std::exception_ptr error;
+
+    void startWorkers();
+    void stopWorkers();
+    void worker(int thread);
+    void runPhase(Phase next);
+    void work(int thread);
+
+    void load(Machine *machine, Snapshot &state, const Node &node);
+    bool play(Machine *machine, word_t action);
+    void expand(int thread);
+    void build(int thread);
+    void buildPath(int depthReached, int index);
+};
+
+// start the worker threads, thread 0 being the caller
+void Search::OpaqueData::startWorkers()
+{
+    stopping = false;
+    error = nullptr;
+    for(int thread = 1; thread < threads; thread++) {
+        workers.emplace_back(&OpaqueData::worker, this, thread);
+    }
+}
+
+// stop & join the worker threads
+void Search::OpaqueData::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    started.notify_all();
+
+    for(auto &thread : workers) {
+        thread.join();
+    }
+    workers.clear();
+}
+
+/* Worker thread: run each phase published by runPhase()
+ * Args:
+ *      thread: the index of the thread
+ */
+void Search::OpaqueData::worker(int thread)
+{
+    uint64_t seen {0};
+
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            started.wait(guard, [&]() { return stopping || (round != seen); });
+            if( stopping )
+                return;
+            seen = round;
+        }
+
+        work(thread);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending--;
+        }
+        finished.notify_one();
+    }
+}
+
+/* Run a phase on every thread and wait for its end
+ * Args:
+ *      next: the phase to run
+ */
+void Search::OpaqueData::runPhase(Phase next)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        phase = next;
+        pending = threads - 1;
+        round++;
+    }
+    started.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [&]() { return pending == 0; });
+
+    if( error ) {
+        std::exception_ptr failure = error;
+        error = nullptr;
+        std::rethrow_exception(failure);
+    }
+}
+
+/* Run the current phase, keeping the first exception thrown by the user functions
+ * Args:
+ *      thread: the index of the thread
+ */
+void Search::OpaqueData::work(int thread)
+{
+    try {
+        if( phase == Phase::EXPAND ) {
+            expand(thread);
+        } else {
+            build(thread);
+        }
+    } catch(...) {
+        std::lock_guard<std::mutex> guard(lock);
+        if( !error )
+            error = std::current_exception();
+
+        // the others stop at their next node
+        this->next = frontier.size() + kept.size();
+        memory = memoryLimit + 1;
+    }
+}
+
+/* Restore a node of the frontier into a machine
+ * Args:
+ *      machine: the machine of the thread
+ *      state: the scratch state of the thread
+ *      node: the node
+ */
+void Search::OpaqueData::load(Machine *machine, Snapshot &state, const Node &node)
+{
+    state = states[0];
+    deltaApply(node.delta.data(), node.delta.size(), reinterpret_cast<byte_t*>(&state), sizeof(Snapshot));
+    machine->restore(state, node.memoryHash);
+}
+
+/* Hold an action
+ * Args:
+ *      machine: the machine, in the state to start from
+ *      action: the keyboard status
+ * Returns:
+ *      False if the program crashed on this input
+ */
+bool Search::OpaqueData::play(Machine *machine, word_t action)
+{
+    machine->setKeys(action);
+
+    try {
+        for(int i = 0; i < frames; i++) {
+            machine->runFrame(cycles);
+        }
+    } catch(const std::exception&) {
+        return false;
+    }
+
+    // the keys are set again before each action, two states that only
+    // differ by the keys held are the same state
+    machine->setKeys(0);
+    return true;
+}
+
+/* Try every action on the nodes of the frontier until none is left
+ * The visited set is only read here. A node after the first one reaching
+ * the goal is not expanded, the nodes before it always are.
+ * Args:
+ *      thread: the index of the thread
+ */
+void Search::OpaqueData::expand(int thread)
+{
+    Machine *machine = machines[thread];
+    Snapshot &state = states[thread + 1];
+    std::vector<Candidate> &found = candidates[thread];
+
+    while( memory.load(std::memory_order_relaxed) <= memoryLimit )
+    {
+        size_t index = next.fetch_add(1);
+        if( index >= frontier.size() || index > goalIndex.load() )
+            return;
+
+        const Node &node = frontier[index];
+        load(machine, state, node);
+        memory.fetch_add(actions.size() * sizeof(Candidate), std::memory_order_relaxed);
+
+        for(size_t a = 0; a < actions.size(); a++)
+        {
+            if( a > 0 )
+                machine->restore(state, node.memoryHash);
+
+            if( !play(machine, actions[a]) )
+                continue;
+
+            uint64_t hash = machine->stateHash();
+            if( visitedSet->contains(hash) )
+                continue;
+
+            if( (*goal)(*machine) ) {
+                found.push_back(Candidate{hash, static_cast<int>(index), static_cast<int>(a), 0, true});
+
+                // lower the goal index, the later nodes are useless
+                size_t current = goalIndex.load();
+                while( index < current && !goalIndex.compare_exchange_weak(current, index) ) { }
+                break;
+            }
+
+            int value = *score ? (*score)(*machine) : 0;
+            found.push_back(Candidate{hash, static_cast<int>(index), static_cast<int>(a), value, false});
+        }
+    }
+}
+
+/* Compute the nodes of the next depth from their parent & action
+ * Args:
+ *      thread: the index of the thread
+ */
+void Search::OpaqueData::build(int thread)
+{
+    Machine *machine = machines[thread];
+    Snapshot &state = states[thread + 1];
+
+    while( memory.load(std::memory_order_relaxed) <= memoryLimit )
+    {
+        size_t index = next.fetch_add(1);
+        if( index >= kept.size() )
+            return;
+
+        const Candidate &candidate = kept[index];
+        load(machine, state, frontier[candidate.parent]);
+        play(machine, actions[candidate.action]);
+
+        Node &child = children[index];
+        machine->snapshot(state);
+        deltaEncode(reinterpret_cast<const byte_t*>(&states[0]), reinterpret_cast<const byte_t*>(&state),
+                    sizeof(Snapshot), child.delta);
+        child.delta.shrink_to_fit();
+        child.memoryHash = machine->memoryHash();
+
+        memory.fetch_add(child.delta.size(), std::memory_order_relaxed);
+    }
+}
+
+/* Rebuild the actions leading to a node
+ * Args:
+ *      depthReached: the depth of the node
+ *      index: its index in that depth
+ */
+void Search::OpaqueData::buildPath(int depthReached, int index)
+{
+    path.clear();
+    for(int d = depthReached; d > 0; d--) {
+        const Step &step = steps[d][index];
+        path.push_back(step.action);
+        index = step.parent;
+    }
+
+    std::reverse(path.begin(), path.end());
+}
+
+/* Constructor
+ * Args:
+ *      start: the machine in the state to search from, left untouched
+ */
+Search::Search(const Machine &start) :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for Search structure.");
+    }
+
+    data_->start = &start;
+
+    // no key, then each key alone
+    data_->actions.push_back(0);
+    for(int key = 0; key < 16; key++) {
+        data_->actions.push_back(1 << key);
+    }
+
+    data_->threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Destructor
+Search::~Search()
+{ }
+
+/* Set the actions tried from every state
+ * Args:
+ *      actions: the keyboard status of each action
+ */
+void Search::setActions(const std::vector<word_t> &actions)
+{
+    data_->actions = actions;
+}
+
+/* Set how long each action is held
+ * Args:
+ *      frames: the number of frames
+ */
+void Search::setFramesPerAction(int frames)
+{
+    data_->frames = std::max(1, frames);
+}
+
+/* Set the number of instructions executed per frame
+ * Args:
+ *      cycles: the number of instructions
+ */
+void Search::setCycles(int cycles)
+{
+    data_->cycles = cycles;
+}
+
+/* Set the maximum number of actions in a path
+ * Args:
+ *      depth: the maximum depth
+ */
+void Search::setDepth(int depth)
+{
+    data_->depth = depth;
+}
+
+/* Set the number of states kept at each depth
+ * Args:
+ *      width: the beam width, 0 for a breadth-first search
+ */
+void Search::setBeamWidth(int width)
+{
+    data_->width = std::max(0, width);
+}
+
+/* Set the number of worker threads
+ * Args:
+ *      threads: the number of threads
+ */
+void Search::setThreads(int threads)
+{
+    data_->threads = std::max(1, threads);
+}
+
+/* Set the maximum number of distinct states, new ones are dropped beyond
+ * Args:
+ *      states: the capacity of the visited set
+ */
+void Search::setCapacity(size_t states)
+{
+    data_->capacity = states;
+}
+
+/* Set the memory allowed to the frontier, run() fails beyond
+ * Args:
+ *      bytes: the size of the states of two depths & the states being expanded
+ */
+void Search::setMemoryLimit(size_t bytes)
+{
+    data_->memoryLimit = bytes;
+}
+
+/* Search for a path to a goal
+ * Args:
+ *      goal: returns True when the machine reached the goal
+ *      score: optional, the states with the best scores are kept by the beam
+ * Returns:
+ *      True if the goal was reached, the path is then given by getPath()
+ * Raises:
+ *      VMError if the frontier exceeds the memory limit
+ */
+bool Search::run(const Goal &goal, const Score &score)
+{
+    OpaqueData *d = data_.get();
+
+    d->path.clear();
+    d->steps.clear();
+    d->frontier.clear();
+    d->goal = &goal;
+    d->score = &score;
+
+    VisitedSet visitedSet(d->capacity);
+    d->visitedSet = &visitedSet;
+
+    d->states = std::unique_ptr<Snapshot[]>(new (std::nothrow) Snapshot[d->threads + 1]);
+    if( d->states == nullptr )
+        throw VMError("Unable to allocate memory for Search structure.");
+
+    // one machine per thread, restored from the frontier states
+    MachinePool pool(d->threads);
+    d->machines.clear();
+    for(int i = 0; i < d->threads; i++) {
+        d->machines.push_back(pool.acquire());
+        d->machines.back()->setHashing(true);
+    }
+
+    // root, the frontier states are deltas against it
+    Machine *root = d->machines[0];
+    d->start->snapshot(d->states[0]);
+    root->restore(d->states[0]);
+    root->setKeys(0);
+    root->snapshot(d->states[0]);
+
+    d->frontier.emplace_back();
+    deltaEncode(reinterpret_cast<const byte_t*>(&d->states[0]), reinterpret_cast<const byte_t*>(&d->states[0]),
+                sizeof(Snapshot), d->frontier[0].delta);
+    d->frontier[0].memoryHash = root->memoryHash();
+    d->steps.push_back({Step{-1, 0}});
+    visitedSet.insert(root->stateHash());
+
+    if( goal(*root) ) {
+        d->visited = visitedSet.size();
+        return true;
+    }
+
+    // the workers are stopped on every way out
+    d->candidates.assign(d->threads, std::vector<Candidate>());
+    d->startWorkers();
+    struct Workers
+    {
+        OpaqueData *data;
+        ~Workers() { data->stopWorkers(); }
+    } workers {d};
+
+    size_t frontierBytes = d->frontier[0].delta.size() + sizeof(Node);
+    for(int level = 1; level <= d->depth && !d->frontier.empty(); level++)
+    {
+        // try every action on every node
+        for(auto &list : d->candidates) {
+            list.clear();
+        }
+        d->next = 0;
+        d->goalIndex = d->frontier.size();
+        d->memory = frontierBytes;
+        d->runPhase(Phase::EXPAND);
+
+        if( d->memory > d->memoryLimit )
+            throw VMError("The search frontier exceeds its memory limit.");
+
+        // merge in (parent, action) order, the result does not depend on the threads
+        d->kept.clear();
+        for(auto &list : d->candidates) {
+            d->kept.insert(d->kept.end(), list.begin(), list.end());
+        }
+        std::sort(d->kept.begin(), d->kept.end(), [](const Candidate &a, const Candidate &b) {
+            return (a.parent != b.parent) ? (a.parent < b.parent) : (a.action < b.action);
+        });
+
+        // first new state reaching the goal
+        size_t goalIndex = d->goalIndex;
+        if( goalIndex < d->frontier.size() ) {
+            for(const auto &candidate : d->kept) {
+                if( candidate.goal && candidate.parent == static_cast<int>(goalIndex) ) {
+                    visitedSet.insert(candidate.hash);
+                    d->steps.push_back({Step{candidate.parent, d->actions[candidate.action]}});
+                    break;
+                }
+            }
+            d->buildPath(level, 0);
+            d->visited = visitedSet.size();
+            return true;
+        }
+
+        // drop the states reached twice, the first path to them is kept
+        auto last = std::remove_if(d->kept.begin(), d->kept.end(), [&](const Candidate &candidate) {
+            return !visitedSet.insert(candidate.hash);
+        });
+        d->kept.erase(last, d->kept.end());
+
+        // best scores first
+        std::stable_sort(d->kept.begin(), d->kept.end(), [](const Candidate &a, const Candidate &b) {
+            return a.score > b.score;
+        });
+        if( d->width > 0 && d->kept.size() > static_cast<size_t>(d->width) )
+            d->kept.resize(d->width);
+
+        // compute the next depth
+        d->children.clear();
+        d->children.resize(d->kept.size());
+        d->next = 0;
+        d->memory = frontierBytes + d->kept.size() * (sizeof(Node) + sizeof(Candidate));
+        d->runPhase(Phase::BUILD);
+
+        if( d->memory > d->memoryLimit )
+            throw VMError("The search frontier exceeds its memory limit.");
+
+        std::vector<Step> levelSteps;
+        levelSteps.reserve(d->kept.size());
+        for(const auto &candidate : d->kept) {
+            levelSteps.push_back(Step{candidate.parent, d->actions[candidate.action]});
+        }
+
+        frontierBytes = d->memory - d->kept.size() * sizeof(Candidate) - frontierBytes;
+        d->frontier = std::move(d->children);
+        d->steps.push_back(std::move(levelSteps));
+    }
+
+    d->visited = visitedSet.size();
+    return false;
+}
+
+// Return the actions leading to the goal, one per step
+const std::vector<word_t>& Search::getPath() const
+{
+    return data_->path;
+}
+
+// Return the number of distinct states seen by the last run
+uint64_t Search::getVisited() const
+{
+    return data_->visited;
+}
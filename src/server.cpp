@@ -0,0 +1,436 @@
+/*
+ * server.cpp
+ * Headless emulation server implementation
+ */
+
+// includes
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "machine.h"
+#include "savestate.h"
+#include "binary.h"
+#include "constants.h"
+#include "except.h"
+
+// message signatures
+const char REQUEST_MAGIC[4] = { 'C', '8', 'R', 'Q' };
+const char RESPONSE_MAGIC[4] = { 'C', '8', 'R', 'S' };
+
+// a request as read from the socket
+struct Request
+{
+    word_t mode {0};
+    uint32_t frames {0};
+    uint32_t cycles {0};
+    uint32_t seed {0};
+    std::vector<byte_t> rom;
+    std::vector<byte_t> events;
+};
+
+// Server structure
+struct Server::OpaqueData
+{
+    std::string path;
+    int workers {1};
+
+    int listener {-1};
+
+    // written to wake the workers up when stopping
+    int stopPipe[2] {-1, -1};
+
+    // one machine per worker, reused from one request to the next
+    std::vector<std::unique_ptr<Machine>> pool;
+
+    void create();
+    void destroy();
+
+    bool wait(int fd);
+    bool readAll(int fd, byte_t *buffer, size_t size);
+    bool writeAll(int fd, const byte_t *buffer, size_t size);
+
+    void serve(Machine *machine);
+    bool handle(int fd, Machine *machine, std::vector<byte_t> &output);
+    const char* check(const byte_t *header);
+    std::string emulate(Machine *machine, const Request &request, std::vector<byte_t> &output);
+    bool respond(int fd, word_t status, uint32_t frames, const byte_t *payload, size_t size);
+};
+
+// initialize structure
+void Server::OpaqueData::create()
+{
+    // pooled machines
+    for(int i = 0; i < workers; i++) {
+        std::unique_ptr<Machine> machine(new (std::nothrow) Machine);
+        if( machine == nullptr )
+            throw VMError("Unable to allocate memory for a pooled Machine.");
+
+        pool.push_back(std::move(machine));
+    }
+
+    if( ::pipe(stopPipe) != 0 )
+        throw VMError("Unable to create the server stop pipe.");
+
+    // listening socket, a stale one left by a previous run is replaced
+    sockaddr_un address {};
+    if( path.size() >= sizeof(address.sun_path) )
+        throw VMError("Socket path is too long.");
+
+    address.sun_family = AF_UNIX;
+    ::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if( listener < 0 )
+        throw VMError("Unable to create the server socket.");
+
+    ::unlink(path.c_str());
+    if( ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 )
+        throw VMError("Unable to bind the server socket.");
+
+    if( ::listen(listener, SOMAXCONN) != 0 )
+        throw VMError("Unable to listen on the server socket.");
+
+    // several workers wait on the same socket, only one gets the client
+    ::fcntl(listener, F_SETFL, ::fcntl(listener, F_GETFL) | O_NONBLOCK);
+}
+
+// de-initialize structure
+void Server::OpaqueData::destroy()
+{
+    if( listener >= 0 ) {
+        ::close(listener);
+        ::unlink(path.c_str());
+    }
+
+    for(int fd : stopPipe) {
+        if( fd >= 0 )
+            ::close(fd);
+    }
+}
+
+/* Wait for a file descriptor to be readable
+ * Args:
+ *      fd: the file descriptor
+ * Returns:
+ *      False when the server is stopping
+ */
+bool Server::OpaqueData::wait(int fd)
+{
+    pollfd fds[2] = {
+        { fd, POLLIN, 0 },
+        { stopPipe[0], POLLIN, 0 }
+    };
+
+    while( ::poll(fds, 2, -1) < 0 ) {
+        if( errno != EINTR )
+            return false;
+    }
+
+    return (fds[1].revents == 0);
+}
+
+/* Read a block of data from a client
+ * Args:
+ *      fd: the client socket
+ *      buffer: the destination
+ *      size: the number of bytes to read
+ * Returns:
+ *      False when the connection is closed or the server stopping
+ */
+bool Server::OpaqueData::readAll(int fd, byte_t *buffer, size_t size)
+{
+    while( size > 0 )
+    {
+        if( !wait(fd) )
+            return false;
+
+        ssize_t count = ::recv(fd, buffer, size, 0);
+        if( count < 0 && errno == EINTR )
+            continue;
+        if( count <= 0 )
+            return false;
+
+        buffer += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+/* Write a block of data to a client
+ * Args:
+ *      fd: the client socket
+ *      buffer: the source
+ *      size: the number of bytes to write
+ * Returns:
+ *      False when the connection is closed
+ */
+bool Server::OpaqueData::writeAll(int fd, const byte_t *buffer, size_t size)
+{
+    while( size > 0 )
+    {
+        ssize_t count = ::send(fd, buffer, size, MSG_NOSIGNAL);
+        if( count < 0 && errno == EINTR )
+            continue;
+        if( count <= 0 )
+            return false;
+
+        buffer += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+/* Worker loop: accept clients and answer their requests
+ * Args:
+ *      machine: the pooled machine owned by this worker
+ */
+void Server::OpaqueData::serve(Machine *machine)
+{
+    std::vector<byte_t> output;
+
+    while( wait(listener) )
+    {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if( fd < 0 )
+            continue;   // another worker got the client
+
+        while( handle(fd, machine, output) )
+            ;
+
+        ::close(fd);
+    }
+}
+
+/* Read a request from a client, run it and send the response
+ * Args:
+ *      fd: the client socket
+ *      machine: the machine to run the request on
+ *      output: the response payload buffer
+ * Returns:
+ *      False when the connection must be closed
+ */
+bool Server::OpaqueData::handle(int fd, Machine *machine, std::vector<byte_t> &output)
+{
+    byte_t header[Protocol::REQUEST_SIZE];
+    if( !readAll(fd, header, sizeof(header)) )
+        return false;
+
+    // the rest of the stream cannot be trusted after a bad header
+    const char *error = check(header);
+    if( error != nullptr ) {
+        respond(fd, Protocol::BAD_REQUEST, 0, reinterpret_cast<const byte_t*>(error), ::strlen(error));
+        return false;
+    }
+
+    Request request;
+    request.mode = getW(&header[6]);
+    request.frames = getL(&header[8]);
+    request.cycles = getL(&header[12]);
+    request.seed = getL(&header[16]);
+    request.rom.resize(getL(&header[20]));
+    request.events.resize(getL(&header[24]) * Protocol::EVENT_SIZE);
+
+    if( request.cycles == 0 )
+        request.cycles = Constants::CYCLES_PER_FRAME;
+
+    if( !readAll(fd, request.rom.data(), request.rom.size()) )
+        return false;
+    if( !readAll(fd, request.events.data(), request.events.size()) )
+        return false;
+
+    std::string failure = emulate(machine, request, output);
+    if( !failure.empty() )
+        return respond(fd, Protocol::FAILURE, 0, reinterpret_cast<const byte_t*>(failure.data()), failure.size());
+
+    return respond(fd, Protocol::OK, request.frames, output.data(), output.size());
+}
+
+/* Validate a request header
+ * Args:
+ *      header: the request header
+ * Returns:
+ *      the error message, nullptr if the header is valid
+ */
+const char* Server::OpaqueData::check(const byte_t *header)
+{
+    if( ::memcmp(header, REQUEST_MAGIC, sizeof(REQUEST_MAGIC)) != 0 )
+        return "Invalid request signature.";
+
+    if( getW(&header[4]) != Protocol::VERSION )
+        return "Unsupported protocol version.";
+
+    word_t mode = getW(&header[6]);
+    uint32_t frames = getL(&header[8]);
+    if( mode > Protocol::FRAMES )
+        return "Unknown request mode.";
+
+    if( frames > ((mode == Protocol::FRAMES) ? Protocol::MAX_RAW_FRAMES : Protocol::MAX_FRAMES) )
+        return "Too many frames requested.";
+
+    if( getL(&header[12]) > Protocol::MAX_CYCLES )
+        return "Too many instructions per frame.";
+
+    uint32_t size = getL(&header[20]);
+    if( size == 0 || size > MemoryZone::CODE_SIZE )
+        return "Invalid ROM size.";
+
+    if( getL(&header[24]) > Protocol::MAX_EVENTS )
+        return "Too many input events.";
+
+    return nullptr;
+}
+
+/* Run a request on a pooled machine
+ * Args:
+ *      machine: the machine to run the request on
+ *      request: the request
+ *      output: the response payload
+ * Returns:
+ *      the error message, copied out of the exception, empty on success
+ */
+std::string Server::OpaqueData::emulate(Machine *machine, const Request &request, std::vector<byte_t> &output)
+{
+    output.clear();
+
+    try
+    {
+        // reuse the machine, nothing from the previous request survives
+        machine->loadRom(request.rom.data(), request.rom.size());
+        machine->powerOn();
+        machine->setSeed(request.seed);
+
+        const byte_t *screen = machine->getMMU()->getPointer(MemoryZone::SCREEN_BEGIN);
+        const byte_t *event = request.events.data();
+        const byte_t *lastEvent = event + request.events.size();
+
+        if( request.mode == Protocol::HASHES )
+            output.resize(request.frames * sizeof(uint64_t));
+        else if( request.mode == Protocol::FRAMES )
+            output.resize(request.frames * MemoryZone::SCREEN_SIZE);
+
+        for(uint32_t frame = 0; frame < request.frames; frame++)
+        {
+            // input events for this frame
+            while( (event < lastEvent) && (getL(event) <= frame) ) {
+                machine->setKeys(getW(event + 4));
+                event += Protocol::EVENT_SIZE;
+            }
+
+            machine->runFrame(request.cycles);
+
+            if( request.mode == Protocol::HASHES ) {
+                uint64_t hash {14695981039346656037ull};
+                for(int i = 0; i < MemoryZone::SCREEN_SIZE; i++) {
+                    hash = (hash ^ screen[i]) * 1099511628211ull;
+                }
+                putQ(&output[frame * sizeof(uint64_t)], hash);
+            } else if( request.mode == Protocol::FRAMES ) {
+                ::memcpy(&output[frame * MemoryZone::SCREEN_SIZE], screen, MemoryZone::SCREEN_SIZE);
+            }
+        }
+
+        if( request.mode == Protocol::SNAPSHOT )
+            saveState(*machine, output, false);
+    }
+    catch(std::exception &e)
+    {
+        std::string message(e.what());
+        return message.empty() ? std::string("Emulation error.") : message;
+    }
+
+    return std::string();
+}
+
+/* Send a response to a client
+ * Args:
+ *      fd: the client socket
+ *      status: the request status
+ *      frames: the number of frames emulated
+ *      payload: the response payload
+ *      size: the size of the payload
+ * Returns:
+ *      False when the connection is closed
+ */
+bool Server::OpaqueData::respond(int fd, word_t status, uint32_t frames, const byte_t *payload, size_t size)
+{
+    byte_t header[Protocol::RESPONSE_SIZE] {};
+    ::memcpy(&header[0], RESPONSE_MAGIC, sizeof(RESPONSE_MAGIC));
+    putW(&header[4], Protocol::VERSION);
+    putW(&header[6], status);
+    putL(&header[8], frames);
+    putL(&header[12], size);
+
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, payload, size);
+}
+
+/* Constructor
+ * Args:
+ *      path: the path of the UNIX socket
+ *      workers: the number of requests served in parallel
+ * Raises:
+ *      VMError in case of issues
+ */
+Server::Server(const std::string &path, int workers) :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for Server structure.");
+    }
+
+    data_->path = path;
+    data_->workers = (workers > 0) ? workers : 1;
+
+    try {
+        data_->create();
+    } catch(...) {
+        data_->destroy();
+        throw;
+    }
+}
+
+// Destructor
+Server::~Server()
+{
+    data_->destroy();
+}
+
+// Serve clients until SIGINT or SIGTERM is received
+void Server::run()
+{
+    // only this thread receives the stop signals
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::vector<std::thread> threads;
+    for(auto &machine : data_->pool) {
+        threads.emplace_back(&OpaqueData::serve, data_.get(), machine.get());
+    }
+
+    int signal {0};
+    ::sigwait(&signals, &signal);
+
+    // wake the workers up, they leave after their current request
+    byte_t stop {1};
+    if( ::write(data_->stopPipe[1], &stop, 1) != 1 )
+        std::cerr << "Unable to stop the workers." << std::endl;
+
+    for(auto &thread : threads) {
+        thread.join();
+    }
+}
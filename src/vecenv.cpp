@@ -0,0 +1,274 @@
+/*
+ * vecenv.cpp
+ * Vectorized environment implementation
+ */
+
+// includes
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vecenv.h"
+#include "pool.h"
+#include "constants.h"
+#include "except.h"
+
+// VecEnv structure
+struct VecEnv::OpaqueData
+{
+    // the machines live next to each other in a single arena
+    std::unique_ptr<MachinePool> pool;
+    std::vector<Machine*> machines;
+    int cycles {Constants::CYCLES_PER_FRAME};
+
+    // worker k steps the machines of slice k + 1, the caller the first one
+    std::vector<std::thread> workers;
+    std::vector<int> slices;
+
+    // current step, published to the workers under the lock
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable finished;
+    uint64_t round {0};
+    int pending {0};
+    bool stopping {false};
+    std::exception_ptr error;               // first failure of the current step
+
+    const word_t *keys {nullptr};
+    int frames {0};
+    byte_t *observations {nullptr};
+
+    void create(int count, int threads);
+    void destroy();
+
+    void work(int slice);
+    void worker(int slice);
+};
+
+// initialize structure
+void VecEnv::OpaqueData::create(int count, int threads)
+{
+    pool = std::unique_ptr<MachinePool>(new (std::nothrow) MachinePool(count));
+    if( pool == nullptr )
+        throw VMError("Unable to allocate memory for the environment pool.");
+
+    for(int i = 0; i < count; i++) {
+        Machine *machine = pool->acquire();
+        machine->setSeed(i + 1);
+        machines.push_back(machine);
+    }
+
+    // split the machines in contiguous slices, one per thread
+    threads = std::max(1, std::min(threads, count));
+    for(int i = 0; i <= threads; i++) {
+        slices.push_back(static_cast<long>(count) * i / threads);
+    }
+
+    // the threads already started are stopped if another one cannot be
+    try {
+        for(int i = 1; i < threads; i++) {
+            workers.emplace_back(&OpaqueData::worker, this, i);
+        }
+    } catch(...) {
+        destroy();
+        throw;
+    }
+}
+
+// de-initialize structure
+void VecEnv::OpaqueData::destroy()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    started.notify_all();
+
+    for(auto &thread : workers) {
+        thread.join();
+    }
+    workers.clear();
+}
+
+/* Step the machines of one slice
+ * Args:
+ *      slice: the index of the slice
+ */
+void VecEnv::OpaqueData::work(int slice)
+{
+    try
+    {
+        for(int i = slices[slice]; i < slices[slice + 1]; i++)
+        {
+            Machine *machine = machines[i];
+
+            machine->setKeys(keys[i]);
+            for(int frame = 0; frame < frames; frame++) {
+                machine->runFrame(cycles);
+            }
+
+            ::memcpy(observations + i * MemoryZone::SCREEN_SIZE,
+                     machine->getMMU()->getPointer(MemoryZone::SCREEN_BEGIN),
+                     MemoryZone::SCREEN_SIZE);
+        }
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if( !error )
+            error = std::current_exception();
+    }
+}
+
+/* Worker loop: step its slice each time a new round starts
+ * Args:
+ *      slice: the index of the slice owned by this worker
+ */
+void VecEnv::OpaqueData::worker(int slice)
+{
+    uint64_t seen {0};
+
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            started.wait(guard, [&]() { return stopping || round != seen; });
+            if( stopping )
+                return;
+            seen = round;
+        }
+
+        work(slice);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending--;
+        }
+        finished.notify_one();
+    }
+}
+
+/* Constructor
+ * Args:
+ *      count: the number of environments
+ *      threads: the number of threads stepping them, the caller included
+ * Raises:
+ *      VMError in case of issues
+ */
+VecEnv::VecEnv(int count, int threads) :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for VecEnv structure.");
+    }
+
+    data_->create(count, threads);
+}
+
+// Destructor
+VecEnv::~VecEnv()
+{
+    data_->destroy();
+}
+
+// Return the number of environments
+int VecEnv::size() const
+{
+    return data_->machines.size();
+}
+
+/* Return the machine of one environment
+ * Args:
+ *      index: the index of the environment
+ */
+Machine& VecEnv::get(int index)
+{
+    return *data_->machines[index];
+}
+
+/* Load the same ROM in every environment and power them on
+ * Args:
+ *      buffer: the ROM content
+ *      size: the size of the ROM
+ */
+void VecEnv::loadRom(const byte_t *buffer, word_t size)
+{
+    for(auto &machine : data_->machines) {
+        machine->loadRom(buffer, size);
+    }
+
+    reset();
+}
+
+// Power every environment on, environment i gets the seed i + 1
+void VecEnv::reset()
+{
+    for(int i = 0; i < size(); i++) {
+        reset(i, i + 1);
+    }
+}
+
+/* Power one environment on, typically at the end of an episode
+ * Args:
+ *      index: the index of the environment
+ *      seed: the state of its random generator
+ */
+void VecEnv::reset(int index, uint32_t seed)
+{
+    Machine *machine = data_->machines[index];
+
+    machine->powerOn();
+    machine->setSeed(seed);
+}
+
+/* Set the number of instructions executed per frame
+ * Args:
+ *      cycles: the number of instructions
+ */
+void VecEnv::setCycles(int cycles)
+{
+    data_->cycles = cycles;
+}
+
+/* Step every environment in parallel
+ * Nothing is allocated: the keys are written in the KEYBOARD_STATUS register
+ * and the screens copied straight in the caller buffer.
+ * Args:
+ *      keys: the keyboard status of each environment
+ *      frames: the number of frames to emulate
+ *      observations: the destination of the screens, uint8_t[N][32][64]
+ * Raises:
+ *      the exception of the first machine that failed, the other ones are
+ *      stepped nonetheless
+ */
+void VecEnv::step(const word_t *keys, int frames, byte_t *observations)
+{
+    OpaqueData *d = data_.get();
+
+    {
+        std::lock_guard<std::mutex> guard(d->lock);
+        d->keys = keys;
+        d->frames = frames;
+        d->observations = observations;
+        d->error = nullptr;
+        d->pending = d->workers.size();
+        d->round++;
+    }
+    d->started.notify_all();
+
+    // the caller steps the first slice
+    d->work(0);
+
+    std::unique_lock<std::mutex> guard(d->lock);
+    d->finished.wait(guard, [&]() { return d->pending == 0; });
+
+    if( d->error ) {
+        std::exception_ptr failure = d->error;
+        d->error = nullptr;
+        std::rethrow_exception(failure);
+    }
+}
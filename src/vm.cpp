@@ -4,93 +4,213 @@
  */
 
 // includes
-#include <fstream>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
 #include <SDL2/SDL.h>
 
 #include "vm.h"
-#include "mmu.h"
-#include "cpu.h"
+#include "machine.h"
 #include "display.h"
 #include "keyboard.h"
-#include "romset.h"
+#include "rewind.h"
+#include "movie.h"
+#include "savestate.h"
+#include "watcher.h"
+#include "assembler.h"
 #include "constants.h"
 #include "except.h"
 
+// frames emulated between two clock checks in turbo mode
+constexpr int TURBO_BATCH = 16;
+
+// rewind history: one snapshot every 2 frames, 5 minutes at 60 fps
+constexpr int REWIND_INTERVAL = 2;
+constexpr int REWIND_CAPACITY = 5 * 60 * 60 / REWIND_INTERVAL;
+
+// what the input movie is doing
+enum MovieMode {
+    MOVIE_NONE = 0,
+    MOVIE_RECORD,
+    MOVIE_PLAY
+};
+
 // Virtual Machine structure
 struct VM::OpaqueData
 {
-    std::unique_ptr<MMU> memory;
-    std::unique_ptr<CPU> cpu;
+    std::unique_ptr<Machine> machine;
     std::unique_ptr<Display> display;
     std::unique_ptr<Keyboard> keyboard;
+    std::unique_ptr<RewindBuffer> rewind;
+
+    // run-ahead frames & the state to come back to
+    int runahead {0};
+
+    // frames displayed per second in turbo mode
+    int turborate {10};
+    std::unique_ptr<Snapshot> present;
+
+    // save state file for the ROM loaded
+    std::string statefile;
+
+    // input movie being recorded or played
+    std::unique_ptr<Movie> movie;
+    MovieMode movieMode {MOVIE_NONE};
+    std::string moviefile;
+
+    // program reloaded when its file changes, ROM or assembly source
+    std::unique_ptr<FileWatcher> watcher;
+    std::string watchfile;
+    bool keepInput {false};
 
     void create();
     void destroy();
-    void initMemory();
-    void updateTimers();
+    void runFrame(int cycles, bool history);
+    bool reload();
 };
 
 // initialize structure
 void VM::OpaqueData::create()
 {
-    // create main memory management unit
-    memory = std::unique_ptr<MMU>(new (std::nothrow) MMU);
-    if( memory == nullptr )
-        throw VMError("Unable to allocate memory for the Memory Unit.");
+    // create the headless machine (memory, CPU & timers)
+    machine = std::unique_ptr<Machine>(new (std::nothrow) Machine);
+    if( machine == nullptr )
+        throw VMError("Unable to allocate memory for the Machine.");
 
+    MMU *memory = machine->getMMU();
 
     // create display
     display = std::unique_ptr<Display>(new (std::nothrow) Display(
-                                    memory.get(),
+                                    memory,
                                     MemoryDefaultValue::SCREEN_WIDTH, MemoryDefaultValue::SCREEN_HEIGHT,
                                     MemoryDefaultValue::SCREEN_XSCALE, MemoryDefaultValue::SCREEN_YSCALE));
     if( display == nullptr )
         throw VMError("Unable to allocate memory for the Display Unit.");
 
     // create the keyboard
-    keyboard = std::unique_ptr<Keyboard>(new (std::nothrow) Keyboard(memory.get()));
+    keyboard = std::unique_ptr<Keyboard>(new (std::nothrow) Keyboard(memory));
     if( keyboard == nullptr )
         throw VMError("Unable to allocate memory for the Keyboard Unit.");
 
+    // create the rewind buffer
+    rewind = std::unique_ptr<RewindBuffer>(new (std::nothrow) RewindBuffer(REWIND_CAPACITY, REWIND_INTERVAL));
+    if( rewind == nullptr )
+        throw VMError("Unable to allocate memory for the Rewind buffer.");
 
-    // create CPU
-    cpu = std::unique_ptr<CPU>(new (std::nothrow) CPU(memory.get()));
-    if( cpu == nullptr )
-        throw VMError("Unable to allocate memory for the CPU Unit.");
+    present = std::unique_ptr<Snapshot>(new (std::nothrow) Snapshot);
+    if( present == nullptr )
+        throw VMError("Unable to allocate memory for the run-ahead snapshot.");
 
-    // init the memory
-    initMemory();
+    // create the input movie, used when recording or playing
+    movie = std::unique_ptr<Movie>(new (std::nothrow) Movie);
+    if( movie == nullptr )
+        throw VMError("Unable to allocate memory for the input movie.");
 }
 
 // de-initialize structure
 void VM::OpaqueData::destroy()
 { }
 
-// initialize VM memory
-void VM::OpaqueData::initMemory()
+/* Emulate one frame, recording or replaying its input, and record the history
+ * Args:
+ *      cycles: the instructions per frame, replaced by the movie's when playing
+ *      history: record the frame in the rewind buffer
+ */
+void VM::OpaqueData::runFrame(int cycles, bool history)
 {
-    // initialize the romset
-    memory->loadMemory(MemoryZone::ROM_BEGIN, sizeof(romset), &romset[0]);
+    if( movieMode == MOVIE_RECORD ) {
+        movie->recordFrame(*machine, cycles);
+    } else if( (movieMode == MOVIE_PLAY) && !movie->playFrame(*machine, cycles) ) {
+        // the player takes the control back
+        std::cout << "Movie finished after " << movie->frames() << " frames." << std::endl;
+        movieMode = MOVIE_NONE;
+    }
+
+    machine->runFrame(cycles);
+    if( history )
+        rewind->record(*machine);
+
+    if( movieMode == MOVIE_RECORD )
+        movie->recordState(*machine);
+    else if( (movieMode == MOVIE_PLAY) && !movie->verifyFrame(*machine) )
+        std::cerr << movie->getDivergence();
 }
 
-// update timers
-void VM::OpaqueData::updateTimers()
+/* Load the watched program again and restart it, the window is kept
+ * When the program cannot be loaded, the error is reported and the
+ * previous one keeps running.
+ * Returns:
+ *      True if the program was reloaded
+ */
+bool VM::OpaqueData::reload()
 {
-    byte_t value{0};
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    word_t keys = machine->getKeys();
+
+    // the files read are watched even when the program is wrong, the fix may be in an include
+    std::vector<std::string> files;
+    bool loaded {true};
+    try {
+        loadProgram(*machine, watchfile, &files);
+    } catch(const VMError &e) {
+        std::cerr << e.what() << std::endl;
+        loaded = false;
+    }
+
+    try {
+        watcher->watch(files);
+    } catch(const VMError &e) {
+        std::cerr << e.what() << std::endl;
+    }
+
+    if( !loaded )
+        return false;
+
+    machine->powerOn();
+    if( keepInput )
+        machine->setKeys(keys);
+    rewind->clear();
+
+    double elapsed = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+    std::cout << "Reloaded " << watchfile << " in " << std::fixed << std::setprecision(2)
+              << elapsed << " ms" << std::endl;
+    return true;
+}
 
-    // update sound timer
-    value = memory->readB(MemoryRegister::SOUND_TIMER);
-    if(value > 0) {
-        value--;
-        memory->writeB(MemoryRegister::SOUND_TIMER, value);
+/* Load a program in the code zone of a machine
+ * A file ending with .asm is assembled in memory and loaded straight from
+ * the assembler output, the assembly errors are reported with their line.
+ * Args:
+ *      machine: the target machine
+ *      filename: a ROM or an assembly source
+ *      files: optional, receives the files read, the includes too, even on failure
+ * Raises:
+ *      VMError in case of issues
+ */
+void loadProgram(Machine &machine, const std::string &filename, std::vector<std::string> *files)
+{
+    const std::string extension {".asm"};
+    if( (filename.size() <= extension.size()) ||
+        (filename.compare(filename.size() - extension.size(), extension.size(), extension) != 0) ) {
+        if( files != nullptr )
+            files->assign(1, filename);
+        machine.loadRom(filename);
+        return;
     }
 
-    // update delay timer
-    value = memory->readB(MemoryRegister::DELAY_TIMER);
-    if(value > 0) {
-        value--;
-        memory->writeB(MemoryRegister::DELAY_TIMER, value);
+    Assembler assembler;
+    bool compiled = assembler.compile(filename);
+    if( files != nullptr )
+        *files = assembler.getFiles();
+
+    if( !compiled ) {
+        std::cerr << assembler.getError() << std::endl;
+        throw VMError("Unable to assemble the program.");
     }
+
+    machine.loadRom(assembler.getCode(), assembler.getSize());
 }
 
 // Constructor
@@ -127,16 +247,25 @@ void VM::run()
     bool quit = false;
     SDL_Event e;
 
-    int fps = 60;
-    int framerate = 1000 / fps;
+    int framerate = 1000 / Constants::FRAMES_PER_SECOND;
     int lasttime = SDL_GetTicks();
     int speed = 1;
     bool isPaused = false;
+    bool isRewinding = false;
+
+    // turbo mode statistics
+    bool isTurbo = false;
+    int turboFrames = 0;
+    int turboTime = SDL_GetTicks();
 
     while(!quit)
     {
+        // the program changed on disk
+        if( (data_->watcher != nullptr) && data_->watcher->changed() )
+            data_->reload();
+
         // treats all events
-        if( SDL_PollEvent(&e) != 0 ) {
+        while( SDL_PollEvent(&e) != 0 ) {
             if( e.type == SDL_QUIT )
                 quit = true;
             else
@@ -163,79 +292,268 @@ void VM::run()
                                 speed = 1;
                             break;
 
+                        case SDLK_F4:           // Toggle the turbo mode
+                            isTurbo = !isTurbo;
+                            turboFrames = 0;
+                            turboTime = SDL_GetTicks();
+                            if( !isTurbo )
+                                data_->display->setTitle("");
+                            break;
+
+                        case SDLK_F5:           // Save the emulator state
+                            saveState(data_->statefile);
+                            break;
+
+                        case SDLK_F9:           // Restore the emulator state
+                            if( data_->movieMode == MOVIE_NONE )
+                                loadState(data_->statefile);
+                            break;
+
                         case SDLK_F10:          // Reset the emulator
+                            if( data_->movieMode == MOVIE_PLAY )
+                                break;
                             speed = 1;
-                            data_->cpu->reset();
+                            data_->machine->reset();
+                            if( data_->movieMode == MOVIE_RECORD )
+                                data_->movie->recordReset(*data_->machine);
                             break;
 
                         case SDLK_p:            // Pause/unpause the emulator
                             isPaused = !isPaused;
                             break;
 
+                        case SDLK_BACKSPACE:    // Rewind while the key is held
+                            isRewinding = (data_->movieMode == MOVIE_NONE);
+                            break;
+
                         default:
-                            data_->keyboard->update(e);
+                            if( data_->movieMode != MOVIE_PLAY )
+                                data_->keyboard->update(e);
                     }
                 }
 
-                if( e.type == SDL_KEYUP )
-                    data_->keyboard->update(e);
+                if( e.type == SDL_KEYUP ) {
+                    if( e.key.keysym.sym == SDLK_BACKSPACE )
+                        isRewinding = false;
+                    else if( data_->movieMode != MOVIE_PLAY )
+                        data_->keyboard->update(e);
+                }
             }
         }
 
+        int cycles = speed * Constants::CYCLES_PER_FRAME;
+        bool isUncapped = isTurbo && !isPaused && !isRewinding;
+
         if( !isPaused )
         {
-            // update CPU
-            for(int i =0; i<speed; i++) {
-                data_->cpu->update();
-            }
-        }
+            if( isRewinding ) {
+                // step back one snapshot, keeping the keys currently pressed
+                word_t keys = data_->machine->getKeys();
+                data_->rewind->rewind(*data_->machine);
+                data_->machine->setKeys(keys);
+            } else if( isTurbo ) {
+                // emulate uncapped until the next frame to display, the history
+                // is recorded at the display rate: a snapshot per emulated frame
+                // would cost more than the frame and fill the buffer in no time
+                int deadline = lasttime + 1000 / data_->turborate;
+                do {
+                    for(int i = 0; i < TURBO_BATCH; i++) {
+                        data_->runFrame(cycles, false);
+                    }
+                    turboFrames += TURBO_BATCH;
+                } while( static_cast<int>(SDL_GetTicks()) < deadline );
+                data_->rewind->record(*data_->machine);
 
-        // update display
-        data_->display->render();
+                // show the achieved speed every second
+                int now = SDL_GetTicks();
+                if( now - turboTime >= 1000 ) {
+                    double multiple = (turboFrames * 1000.0 / (now - turboTime)) / Constants::FRAMES_PER_SECOND;
 
-        if( !isPaused )
-        {
-            // update timers at 60fps
-            if( SDL_GetTicks() - lasttime >= framerate ) {
+                    std::ostringstream title;
+                    title << "Chip-8 Emulator - turbo x" << std::fixed << std::setprecision(1) << multiple;
+                    data_->display->setTitle(title.str());
 
-                // update timers
-                data_->updateTimers();
+                    turboFrames = 0;
+                    turboTime = now;
+                }
+            } else {
+                // emulate one frame (CPU & timers) & record the history
+                data_->runFrame(cycles, true);
+            }
+        }
 
-                // update time variable
-                lasttime = SDL_GetTicks();
+        // update display
+        if( (data_->runahead > 0) && !isPaused && !isRewinding && !isUncapped ) {
+            // show the frame the ROM would produce a few frames later
+            // with the current input, then come back to the present
+            data_->machine->snapshot(*data_->present);
+            for(int i = 0; i < data_->runahead; i++) {
+                data_->machine->runFrame(cycles);
             }
+            data_->display->render();
+            data_->machine->restore(*data_->present);
+        } else {
+            data_->display->render();
         }
+
+        // wait for the next frame, the turbo mode already used its time
+        int elapsed = SDL_GetTicks() - lasttime;
+        if( (elapsed < framerate) && !isUncapped )
+            SDL_Delay(framerate - elapsed);
+        lasttime = SDL_GetTicks();
     }
 }
 
-// VM shutdown
+/* Set the display rate of the turbo mode
+ * Args:
+ *      fps: the number of frames displayed per second
+ */
+void VM::setTurboRate(int fps)
+{
+    data_->turborate = (fps > 0) ? fps : 1;
+}
+
+/* Set the number of frames to run ahead of the displayed frame
+ * Args:
+ *      frames: the number of frames, 0 to disable
+ */
+void VM::setRunAhead(int frames)
+{
+    data_->runahead = (frames > 0) ? frames : 0;
+}
+
+// VM shutdown, the movie being recorded is written
 void VM::shutdown()
-{ }
+{
+    if( data_->movieMode != MOVIE_RECORD )
+        return;
+
+    try {
+        data_->movie->save(data_->moviefile);
+        std::cout << "Movie of " << data_->movie->frames() << " frames saved to " << data_->moviefile << std::endl;
+    } catch(const MovieError &e) {
+        std::cerr << e.what() << std::endl;
+    }
+
+    data_->movieMode = MOVIE_NONE;
+}
+
+/* Record the input from the power on, the ROM must be loaded
+ * Args:
+ *      filename: the movie written at shutdown
+ *      trace: keep the state reached by each frame to detect desyncs
+ */
+void VM::recordMovie(std::string filename, bool trace)
+{
+    data_->movie->startRecording(*data_->machine, Constants::CYCLES_PER_FRAME, trace);
+    data_->rewind->clear();
+
+    data_->moviefile = filename;
+    data_->movieMode = MOVIE_RECORD;
+}
+
+/* Replay a movie from the power on, the ROM must be loaded
+ * The keyboard is ignored until the end of the movie. The first frame
+ * diverging from a traced movie is reported.
+ * Args:
+ *      filename: the movie to play
+ * Raises:
+ *      MovieError in case of issues
+ */
+void VM::playMovie(std::string filename)
+{
+    data_->movie->load(filename);
+    data_->movie->startPlayback(*data_->machine);
+    data_->rewind->clear();
+
+    data_->moviefile = filename;
+    data_->movieMode = MOVIE_PLAY;
+}
+
+/* Load a ROM, or assemble a source ending with .asm, and reload it each
+ * time the file or one of its includes changes
+ * Args:
+ *      filename: the program to run & watch
+ *      keepInput: keep the keys held across the reloads
+ * Raises:
+ *      VMError in case of issues
+ */
+void VM::watch(std::string filename, bool keepInput)
+{
+    data_->watcher = std::unique_ptr<FileWatcher>(new (std::nothrow) FileWatcher(filename));
+    if( data_->watcher == nullptr )
+        throw VMError("Unable to allocate memory for the file watcher.");
+
+    data_->watchfile = filename;
+    data_->keepInput = keepInput;
+    data_->statefile = filename + ".c8s";
+
+    if( !data_->reload() )
+        throw VMError("Unable to load the watched program.");
+}
 
 /* Load a ROM inside the VM memory
  * Args:
- *      filename: the path to the ROM
+ *      filename: the path to the ROM or to its assembly source
  * Raises:
  *      VMError in case of issues
  */
 void VM::loadRom(std::string filename)
 {
-    std::ifstream romfile (filename, std::ios::in | std::ios::binary | std::ios::ate );
+    loadProgram(*data_->machine, filename);
+    data_->statefile = filename + ".c8s";
+}
 
-    if( !romfile.is_open() ) {
-        throw VMError("Unable to load the ROM.");
+/* Save the VM state to disk
+ * Args:
+ *      filename: the path of the save state
+ */
+void VM::saveState(std::string filename)
+{
+    try {
+        ::saveState(*data_->machine, filename, true);
+    } catch(const StateError &e) {
+        std::cerr << e.what() << std::endl;
     }
+}
 
-    // retrieve the size of the ROM
-    std::streampos size = romfile.tellg();
-    char* memblock = new char[size];
+/* Restore the VM state from disk
+ * Args:
+ *      filename: the path of the save state
+ */
+void VM::loadState(std::string filename)
+{
+    try {
+        ::loadState(*data_->machine, filename);
+    } catch(const StateError &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
 
-    // read the file
-    romfile.seekg(0, std::ios::beg);
-    romfile.read(memblock, size);
-    romfile.close();
+/* Capture the full state of the VM
+ * Args:
+ *      snapshot: the destination snapshot
+ */
+void VM::snapshot(Snapshot &snapshot) const
+{
+    data_->machine->snapshot(snapshot);
+}
 
-    // load the code in memory
-    data_->memory->loadMemory(MemoryZone::CODE_BEGIN, size, reinterpret_cast<byte_t*>(memblock));
-    delete[] memblock;
+/* Restore the full state of the VM
+ * Args:
+ *      snapshot: the source snapshot
+ */
+void VM::restore(const Snapshot &snapshot)
+{
+    data_->machine->restore(snapshot);
+}
+
+/* Fork the running instance
+ * The fork has no display or keyboard attached and runs headless.
+ * Returns:
+ *      a new machine in the current state of the VM
+ */
+std::unique_ptr<Machine> VM::clone() const
+{
+    return data_->machine->clone();
 }
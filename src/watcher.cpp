@@ -0,0 +1,121 @@
+/*
+ * watcher.cpp
+ * File change notification implementation
+ */
+
+// includes
+#include <map>
+#include <set>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "watcher.h"
+#include "except.h"
+
+// FileWatcher structure
+struct FileWatcher::OpaqueData
+{
+    int fd {-1};
+    std::map<int, std::set<std::string>> names;     // files watched in each directory
+};
+
+/* Constructor
+ * Args:
+ *      filename: the file to watch, it may be replaced or recreated
+ * Raises:
+ *      VMError in case of issues
+ */
+FileWatcher::FileWatcher(const std::string &filename) :
+    data_(new (std::nothrow) OpaqueData)
+{
+    if( data_ == nullptr ) {
+        throw VMError("Unable to allocate memory for FileWatcher structure.");
+    }
+
+    data_->fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if( data_->fd < 0 )
+        throw VMError("Unable to initialize the file watcher.");
+
+    try {
+        watch(std::vector<std::string>{filename});
+    } catch(const VMError&) {
+        ::close(data_->fd);
+        throw;
+    }
+}
+
+// Destructor
+FileWatcher::~FileWatcher()
+{
+    ::close(data_->fd);
+}
+
+/* Replace the files watched
+ * The directories kept are never unwatched, no change made meanwhile is lost.
+ * Args:
+ *      filenames: the files to watch, they may be replaced or recreated
+ * Raises:
+ *      VMError in case of issues
+ */
+void FileWatcher::watch(const std::vector<std::string> &filenames)
+{
+    std::map<int, std::set<std::string>> names;
+
+    for(const auto &filename : filenames)
+    {
+        // split the path between the directory and the name of the file
+        std::string directory {"."};
+        std::string name {filename};
+        auto slash = filename.rfind('/');
+        if( slash != std::string::npos ) {
+            directory = (slash == 0) ? "/" : filename.substr(0, slash);
+            name = filename.substr(slash + 1);
+        }
+
+        // a write is complete when the file is closed or renamed into place,
+        // a directory watched twice keeps its descriptor
+        int wd = ::inotify_add_watch(data_->fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if( wd < 0 )
+            throw VMError("Unable to watch the directory of the file.");
+
+        names[wd].insert(name);
+    }
+
+    for(const auto &directory : data_->names) {
+        if( names.count(directory.first) == 0 )
+            ::inotify_rm_watch(data_->fd, directory.first);
+    }
+
+    data_->names.swap(names);
+}
+
+/* Drain the pending notifications
+ * Returns:
+ *      True if one of the files was written or replaced since the last call
+ */
+bool FileWatcher::changed()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed {false};
+
+    while(true)
+    {
+        ssize_t length = ::read(data_->fd, buffer, sizeof(buffer));
+        if( length <= 0 )
+            break;
+
+        for(ssize_t offset = 0; offset < length; )
+        {
+            auto event = reinterpret_cast<const struct inotify_event*>(&buffer[offset]);
+            if( event->len > 0 ) {
+                auto directory = data_->names.find(event->wd);
+                if( (directory != data_->names.end()) && (directory->second.count(event->name) > 0) )
+                    changed = true;
+            }
+
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}